@@ -0,0 +1,289 @@
+#include "menu_model.h"
+
+#include <string.h>
+
+#include <string>
+
+namespace {
+
+bool same_string(const char* a, const char* b) {
+  return strcmp(a, b) == 0;
+}
+
+}  // namespace
+
+MenuModel::MenuModel() noexcept {
+  clear();
+}
+
+void MenuModel::clear() {
+  items_.clear();
+  index_.clear();
+  strings_.assign(1, '\0');
+  unused_string_bytes_ = 0;
+}
+
+void MenuModel::reserve(size_t items, size_t string_bytes) {
+  items_.reserve(items);
+  index_.reserve(items);
+  strings_.reserve(string_bytes + 1);
+}
+
+uint32_t MenuModel::append_item(const MenuItemFields& fields) {
+  uint32_t index = size();
+
+  Item item;
+  item.type = fields.type;
+  item.enabled = fields.enabled;
+  item.checked = is_toggle(fields.type) && fields.checked;
+  item.end = index + 1;
+  item.parent = kNoMenuItem;
+  item.id = fields.type == MenuItemType::kSeparator ? -1 : fields.id;
+  item.label = add_string(fields.label);
+  item.image = add_string(fields.image);
+  item.native_action = add_string(fields.native_action);
+  items_.push_back(item);
+
+  if (item.id >= 0) {
+    index_[item.id] = index;
+  }
+  return index;
+}
+
+void MenuModel::end_submenu(uint32_t index) {
+  items_[index].end = size();
+
+  // Nested submenus have been ended already, so only the direct children are
+  // left to assign.
+  for (uint32_t i = index + 1; i < size(); i = items_[i].end) {
+    items_[i].parent = index;
+  }
+}
+
+void MenuModel::check_radio_groups() {
+  check_radio_groups(0, size());
+}
+
+void MenuModel::check_radio_groups(uint32_t begin, uint32_t end) {
+  // The first and the last checked item of the group being walked.
+  uint32_t group = kNoMenuItem;
+  uint32_t checked = kNoMenuItem;
+  auto end_group = [&]() {
+    if (group != kNoMenuItem) {
+      items_[checked != kNoMenuItem ? checked : group].checked = true;
+    }
+    group = kNoMenuItem;
+    checked = kNoMenuItem;
+  };
+
+  for (uint32_t i = begin; i < end; i = items_[i].end) {
+    Item& item = items_[i];
+    if (item.type != MenuItemType::kRadio) {
+      end_group();
+      if (item.type == MenuItemType::kSubMenu) {
+        check_radio_groups(i + 1, item.end);
+      }
+      continue;
+    }
+
+    if (group == kNoMenuItem) {
+      group = i;
+    }
+    if (item.checked) {
+      item.checked = false;
+      checked = i;
+    }
+  }
+  end_group();
+}
+
+const char* MenuModel::label(uint32_t index) const {
+  return &strings_[items_[index].label];
+}
+
+const char* MenuModel::image(uint32_t index) const {
+  return &strings_[items_[index].image];
+}
+
+const char* MenuModel::native_action(uint32_t index) const {
+  return &strings_[items_[index].native_action];
+}
+
+std::vector<uint32_t> MenuModel::radio_group(uint32_t index) const {
+  std::vector<uint32_t> group;
+  if (items_[index].type != MenuItemType::kRadio) {
+    return group;
+  }
+
+  uint32_t parent = items_[index].parent;
+  uint32_t begin = parent == kNoMenuItem ? 0 : parent + 1;
+  uint32_t end = parent == kNoMenuItem ? size() : items_[parent].end;
+  for (uint32_t i = begin; i < end; i = items_[i].end) {
+    if (items_[i].type == MenuItemType::kRadio) {
+      group.push_back(i);
+    } else if (i > index) {
+      break;
+    } else {
+      group.clear();
+    }
+  }
+  return group;
+}
+
+uint32_t MenuModel::find(int64_t id) const {
+  auto iter = index_.find(id);
+  return iter != index_.end() ? iter->second : kNoMenuItem;
+}
+
+bool MenuModel::set_label(int64_t id, const char* label) {
+  uint32_t index = find(id);
+  if (index == kNoMenuItem) {
+    return false;
+  }
+
+  replace_string(&items_[index].label, label);
+  return true;
+}
+
+bool MenuModel::set_image(int64_t id, const char* image) {
+  uint32_t index = find(id);
+  if (index == kNoMenuItem) {
+    return false;
+  }
+
+  replace_string(&items_[index].image, image);
+  return true;
+}
+
+bool MenuModel::set_enabled(int64_t id, bool enabled) {
+  uint32_t index = find(id);
+  if (index == kNoMenuItem) {
+    return false;
+  }
+
+  items_[index].enabled = enabled;
+  return true;
+}
+
+bool MenuModel::set_checked(int64_t id, bool checked) {
+  uint32_t index = find(id);
+  if (index == kNoMenuItem || !is_toggle(items_[index].type)) {
+    return false;
+  }
+
+  if (items_[index].type == MenuItemType::kRadio) {
+    if (!checked) {
+      return false;
+    }
+    for (uint32_t i : radio_group(index)) {
+      items_[i].checked = false;
+    }
+  }
+
+  items_[index].checked = checked;
+  return true;
+}
+
+bool MenuModel::toggle(int64_t id) {
+  uint32_t index = find(id);
+  if (index == kNoMenuItem || !is_toggle(items_[index].type)) {
+    return false;
+  }
+
+  return set_checked(id, items_[index].type == MenuItemType::kRadio ||
+                             !items_[index].checked);
+}
+
+// static
+bool MenuModel::diff(const MenuModel& from,
+                     const MenuModel& to,
+                     std::vector<MenuModelChange>* changes) {
+  changes->clear();
+
+  if (from.size() != to.size()) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < to.size(); ++i) {
+    const Item& a = from.items_[i];
+    const Item& b = to.items_[i];
+    if (a.type != b.type || a.id != b.id || a.end != b.end) {
+      changes->clear();
+      return false;
+    }
+
+    uint8_t fields = 0;
+    if (!same_string(from.label(i), to.label(i))) {
+      fields |= kMenuItemLabelChanged;
+    }
+    if (!same_string(from.image(i), to.image(i))) {
+      fields |= kMenuItemImageChanged;
+    }
+    if (a.enabled != b.enabled) {
+      fields |= kMenuItemEnabledChanged;
+    }
+    if (a.checked != b.checked) {
+      fields |= kMenuItemCheckedChanged;
+    }
+    if (!same_string(from.native_action(i), to.native_action(i))) {
+      fields |= kMenuItemNativeActionChanged;
+    }
+
+    if (fields != 0) {
+      changes->push_back(MenuModelChange{i, fields});
+    }
+  }
+  return true;
+}
+
+uint32_t MenuModel::add_string(const char* value) {
+  if (!value || !*value) {
+    return 0;
+  }
+
+  // Inserting may reallocate the buffer |value| points into.
+  if (value >= strings_.data() && value < strings_.data() + strings_.size()) {
+    std::string copy(value);
+    return add_string(copy.c_str());
+  }
+
+  uint32_t offset = static_cast<uint32_t>(strings_.size());
+  strings_.insert(strings_.end(), value, value + strlen(value) + 1);
+  return offset;
+}
+
+void MenuModel::replace_string(uint32_t* offset, const char* value) {
+  if (*offset != 0) {
+    unused_string_bytes_ += strlen(&strings_[*offset]) + 1;
+  }
+  *offset = add_string(value);
+
+  // Labels updated on a timer would otherwise grow the buffer forever.
+  if (unused_string_bytes_ > strings_.size() / 2) {
+    compact_strings();
+  }
+}
+
+void MenuModel::compact_strings() {
+  std::vector<char> strings;
+  strings.reserve(strings_.size() - unused_string_bytes_);
+  strings.push_back('\0');
+
+  auto move_string = [&](uint32_t* offset) {
+    if (*offset == 0) {
+      return;
+    }
+    const char* value = &strings_[*offset];
+    *offset = static_cast<uint32_t>(strings.size());
+    strings.insert(strings.end(), value, value + strlen(value) + 1);
+  };
+
+  for (Item& item : items_) {
+    move_string(&item.label);
+    move_string(&item.image);
+    move_string(&item.native_action);
+  }
+
+  strings_.swap(strings);
+  unused_string_bytes_ = 0;
+}
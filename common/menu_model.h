@@ -0,0 +1,151 @@
+#ifndef __MENU_MODEL_H__
+#define __MENU_MODEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+// The platform-neutral core of a context menu, shared by the Linux and Windows
+// plugins. Each platform parses its method call arguments into a MenuModel
+// with a thin adapter and renders the model with its own toolkit.
+//
+// Items are kept in one flat table in pre-order: a submenu is followed by its
+// descendants, up to end(). Strings live in a single buffer, so building a
+// menu of n items costs a handful of allocations instead of several per item.
+
+enum class MenuItemType : uint8_t {
+  kLabel = 0,
+  kCheckbox = 1,
+  kSubMenu = 2,
+  kSeparator = 3,
+  // Adjacent radio items of the same menu form a group of which at most one
+  // is checked.
+  kRadio = 4,
+};
+
+// What an adapter knows about an item when appending it. Null strings are
+// stored as empty ones.
+struct MenuItemFields {
+  MenuItemType type = MenuItemType::kLabel;
+  int64_t id = -1;
+  const char* label = nullptr;
+  const char* image = nullptr;
+  const char* native_action = nullptr;
+  bool enabled = true;
+  bool checked = false;
+};
+
+// Fields of an item that differ between two menus of the same structure.
+enum MenuItemChange : uint8_t {
+  kMenuItemLabelChanged = 1 << 0,
+  kMenuItemImageChanged = 1 << 1,
+  kMenuItemEnabledChanged = 1 << 2,
+  kMenuItemCheckedChanged = 1 << 3,
+  kMenuItemNativeActionChanged = 1 << 4,
+};
+
+struct MenuModelChange {
+  uint32_t index;
+  uint8_t fields;
+};
+
+constexpr uint32_t kNoMenuItem = UINT32_MAX;
+
+class MenuModel {
+ public:
+  MenuModel() noexcept;
+
+  void clear();
+  void reserve(size_t items, size_t string_bytes);
+
+  // Appends an item after the last one and returns its index. The children of
+  // a submenu are appended right after it, followed by end_submenu().
+  uint32_t append_item(const MenuItemFields& fields);
+  void end_submenu(uint32_t index);
+
+  // Once all items are appended, leaves exactly one item of each radio group
+  // checked, as toolkits show them: the last checked one, or else the first.
+  void check_radio_groups();
+
+  uint32_t size() const { return static_cast<uint32_t>(items_.size()); }
+
+  // Index past the last descendant of |index|, i.e. of its next sibling.
+  uint32_t end(uint32_t index) const { return items_[index].end; }
+
+  MenuItemType type(uint32_t index) const { return items_[index].type; }
+  int64_t id(uint32_t index) const { return items_[index].id; }
+  const char* label(uint32_t index) const;
+  const char* image(uint32_t index) const;
+  const char* native_action(uint32_t index) const;
+  bool enabled(uint32_t index) const { return items_[index].enabled; }
+  bool checked(uint32_t index) const { return items_[index].checked; }
+
+  // The submenu |index| is in, or kNoMenuItem for the top level.
+  uint32_t parent(uint32_t index) const { return items_[index].parent; }
+
+  // Returns the radio group of |index|, itself included, or nothing if it
+  // isn't a radio item.
+  std::vector<uint32_t> radio_group(uint32_t index) const;
+
+  // Returns the index of the item with |id|, or kNoMenuItem.
+  uint32_t find(int64_t id) const;
+
+  // Update the item with |id|. Return false if there is no such item, or for
+  // set_checked(), if it isn't a checkbox or radio item. Checking a radio item
+  // unchecks the rest of its group; it can't be unchecked by itself.
+  bool set_label(int64_t id, const char* label);
+  bool set_image(int64_t id, const char* image);
+  bool set_enabled(int64_t id, bool enabled);
+  bool set_checked(int64_t id, bool checked);
+
+  // Applies a click on the item with |id| the way menus do natively: a
+  // checkbox toggles and a radio item is checked. Returns false if the item
+  // is neither.
+  bool toggle(int64_t id);
+
+  // Compares two menus item by item. Returns false if they differ in
+  // structure, i.e. in item types, ids or nesting, so |to| can't be applied
+  // to widgets rendered from |from|. Otherwise fills |changes| with the items
+  // whose other fields differ.
+  static bool diff(const MenuModel& from,
+                   const MenuModel& to,
+                   std::vector<MenuModelChange>* changes);
+
+  // Bytes held by the string buffer, replaced strings included.
+  size_t string_bytes() const { return strings_.size(); }
+
+ protected:
+  struct Item {
+    MenuItemType type;
+    bool enabled;
+    bool checked;
+    uint32_t end;
+    uint32_t parent;
+    int64_t id;
+    // Offsets into strings_, 0 being the empty string.
+    uint32_t label;
+    uint32_t image;
+    uint32_t native_action;
+  };
+
+  static bool is_toggle(MenuItemType type) {
+    return type == MenuItemType::kCheckbox || type == MenuItemType::kRadio;
+  }
+
+  void check_radio_groups(uint32_t begin, uint32_t end);
+
+  uint32_t add_string(const char* value);
+  void replace_string(uint32_t* offset, const char* value);
+  void compact_strings();
+
+  std::vector<Item> items_;
+  std::vector<char> strings_;
+  // Bytes of strings_ no longer referenced by any item.
+  size_t unused_string_bytes_ = 0;
+
+  std::unordered_map<int64_t, uint32_t> index_;
+};
+
+#endif  // __MENU_MODEL_H__
@@ -0,0 +1,176 @@
+// End-to-end latency of the Linux tray against the example application.
+//
+// Runs headless under Xvfb, with the plugin's headless indicator standing in
+// for the status notifier host:
+//
+//   cd example
+//   SYSTEM_TRAY_HEADLESS_INDICATOR=1 xvfb-run -a \
+//       flutter test integration_test/latency_test.dart -d linux
+//
+// Results are written as JSON to $SYSTEM_TRAY_E2E_RESULTS, or to
+// build/system_tray_latency.json, so runs can be compared across changes.
+
+import 'dart:async';
+import 'dart:convert';
+import 'dart:io';
+
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:integration_test/integration_test.dart';
+import 'package:system_tray/system_tray.dart';
+import 'package:system_tray_example/main.dart' as app;
+
+const MethodChannel _testingChannel =
+    MethodChannel('flutter/system_tray/testing');
+
+const int _kIterations = 20;
+const List<int> _kMenuSizes = [10, 100, 1000];
+
+const Duration _kVisibleTimeout = Duration(seconds: 30);
+const Duration _kClickTimeout = Duration(seconds: 5);
+
+/// Summary of a set of samples, in microseconds.
+Map<String, int> _summarize(List<int> samples) {
+  final List<int> sorted = List<int>.from(samples)..sort();
+  int percentile(double p) =>
+      sorted[((sorted.length - 1) * p).round().clamp(0, sorted.length - 1)];
+  return <String, int>{
+    'count': sorted.length,
+    'median_us': percentile(0.5),
+    'p95_us': percentile(0.95),
+    'max_us': sorted.last,
+  };
+}
+
+Future<List<int>> _measure(
+    int iterations, Future<void> Function(int) run) async {
+  final List<int> samples = [];
+  for (int i = 0; i < iterations; ++i) {
+    final Stopwatch stopwatch = Stopwatch()..start();
+    await run(i);
+    samples.add(stopwatch.elapsedMicroseconds);
+  }
+  return samples;
+}
+
+List<MenuItemBase> _labels(int count, [MenuItemSelectedCallback? onClicked]) {
+  return List<MenuItemBase>.generate(
+      count,
+      (i) => MenuItemLabel(
+          label: 'Item $i', name: 'item$i', onClicked: onClicked));
+}
+
+Future<Map<dynamic, dynamic>> _waitForIndicator() async {
+  final Stopwatch stopwatch = Stopwatch()..start();
+  for (;;) {
+    final Map<dynamic, dynamic> state =
+        await _testingChannel.invokeMethod('GetIndicatorState');
+    if (state['visible'] == true) {
+      return state;
+    }
+    if (stopwatch.elapsed > _kVisibleTimeout) {
+      throw TimeoutException('The tray never became visible', _kVisibleTimeout);
+    }
+    await Future<void>.delayed(const Duration(milliseconds: 5));
+  }
+}
+
+void main() {
+  final IntegrationTestWidgetsFlutterBinding binding =
+      IntegrationTestWidgetsFlutterBinding.ensureInitialized();
+
+  final Map<String, Object> results = {};
+
+  tearDownAll(() async {
+    binding.reportData = results;
+
+    final String path = Platform.environment['SYSTEM_TRAY_E2E_RESULTS'] ??
+        'build/system_tray_latency.json';
+    final File file = File(path);
+    await file.parent.create(recursive: true);
+    await file
+        .writeAsString(const JsonEncoder.withIndent('  ').convert(results));
+  });
+
+  testWidgets('tray latency', (WidgetTester tester) async {
+    app.main();
+    await tester.pump();
+
+    // Measured natively from process start, so it includes engine startup.
+    final Map<dynamic, dynamic> state = await _waitForIndicator();
+    results['cold_start_to_tray_visible_us'] = state['visible_uptime_us'];
+
+    final SystemTray systemTray = SystemTray();
+
+    final Map<String, Object> menuBuild = {};
+    for (final int size in _kMenuSizes) {
+      final Menu menu = Menu();
+      final List<int> samples = await _measure(_kIterations, (i) async {
+        expect(await menu.buildFrom(_labels(size)), isTrue);
+      });
+      menuBuild['$size'] = _summarize(samples);
+    }
+    results['menu_build'] = menuBuild;
+
+    Completer<MenuItemBase>? clicked;
+    final Menu menu = Menu();
+    expect(
+        await menu.buildFrom([
+          ..._labels(10, (item) => clicked?.complete(item)),
+          MenuItemCheckbox(label: 'Checkbox', name: 'checkbox'),
+        ]),
+        isTrue);
+    await systemTray.setContextMenu(menu);
+
+    final MenuItemBase label = menu.findItemByName<MenuItemBase>('item0')!;
+    final MenuItemBase checkbox =
+        menu.findItemByName<MenuItemBase>('checkbox')!;
+
+    results['set_label'] = _summarize(await _measure(_kIterations, (i) async {
+      await label.setLabel('Item 0 ($i)');
+    }));
+    expect(label.label, 'Item 0 (${_kIterations - 1})');
+
+    results['set_enable'] = _summarize(await _measure(_kIterations, (i) async {
+      await label.setEnable(i.isOdd);
+    }));
+    await label.setEnable(true);
+
+    results['set_check'] = _summarize(await _measure(_kIterations, (i) async {
+      await checkbox.setCheck(i.isEven);
+    }));
+
+    results['set_title'] = _summarize(await _measure(_kIterations, (i) async {
+      await systemTray.setSystemTrayInfo(title: 'system tray $i');
+    }));
+
+    final MenuItemBase target = menu.findItemByName<MenuItemBase>('item5')!;
+    results['click_to_callback'] =
+        _summarize(await _measure(_kIterations, (i) async {
+      clicked = Completer<MenuItemBase>();
+      expect(
+          await _testingChannel.invokeMethod('ActivateMenuItem', {
+            'menu_id': menu.menuId,
+            'menu_item_id': target.menuItemId,
+          }),
+          isTrue);
+      expect(await clicked!.future.timeout(_kClickTimeout), same(target));
+    }));
+
+    final AppWindow appWindow = AppWindow();
+    results['hide_show'] =
+        _summarize(await _measure(_kIterations, (i) async {
+      await appWindow.hide();
+      await appWindow.show();
+    }));
+
+    final ShowLatency? showLatency = await appWindow.getShowLatency();
+    if (showLatency != null && showLatency.count > 0) {
+      results['show_to_first_frame'] = <String, int>{
+        'count': showLatency.count,
+        'average_us': showLatency.average.inMicroseconds,
+        'last_us': showLatency.last.inMicroseconds,
+      };
+    }
+  }, skip: !Platform.isLinux);
+}
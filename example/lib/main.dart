@@ -7,8 +7,13 @@ import 'package:english_words/english_words.dart';
 import 'package:flutter/material.dart';
 import 'package:system_tray/system_tray.dart';
 
-void main() async {
+void main(List<String> args) async {
   WidgetsFlutterBinding.ensureInitialized();
+
+  // Launched with --start-hidden, e.g. at login, the window stays unmapped
+  // until it is shown from the tray or by another launch.
+  final bool startHidden = args.contains('--start-hidden');
+
   runApp(
     const MyApp(),
   );
@@ -20,7 +25,9 @@ void main() async {
     win.size = initialSize;
     win.alignment = Alignment.center;
     win.title = "How to use system tray with Flutter";
-    win.show();
+    if (!startHidden) {
+      win.show();
+    }
   });
 }
 
@@ -70,6 +77,12 @@ class _MyAppState extends State<MyApp> {
     _systemTray.setTitle("system tray");
     _systemTray.setToolTip("How to use system tray with Flutter");
 
+    // bring the window back when the app is launched again
+    _appWindow.registerActivatedHandler((arguments) {
+      debugPrint("activated: $arguments");
+      _appWindow.show();
+    });
+
     // handle system tray event
     _systemTray.registerSystemTrayEventHandler((eventName) {
       debugPrint("eventName: $eventName");
@@ -205,9 +218,9 @@ class _MyAppState extends State<MyApp> {
           onClicked: (menuItem) async {
             debugPrint("click 'Checkbox 1'");
 
+            // Already toggled natively, checked is the new state.
             MenuItemCheckbox? checkbox1 =
                 _menuMain.findItemByName<MenuItemCheckbox>("checkbox1");
-            await checkbox1?.setCheck(!checkbox1.checked);
 
             MenuItemCheckbox? checkbox2 =
                 _menuMain.findItemByName<MenuItemCheckbox>("checkbox2");
@@ -223,7 +236,6 @@ class _MyAppState extends State<MyApp> {
           onClicked: (menuItem) async {
             debugPrint("click 'Checkbox 2'");
 
-            await menuItem.setCheck(!menuItem.checked);
             await menuItem.setLabel(WordPair.random().asPascalCase);
             debugPrint(
                 "click name: ${menuItem.name} menuItemId: ${menuItem.menuItemId} label: ${menuItem.label} checked: ${menuItem.checked}");
@@ -236,7 +248,6 @@ class _MyAppState extends State<MyApp> {
           onClicked: (menuItem) async {
             debugPrint("click 'Checkbox 3'");
 
-            await menuItem.setCheck(!menuItem.checked);
             debugPrint(
                 "click name: ${menuItem.name} menuItemId: ${menuItem.menuItemId} label: ${menuItem.label} checked: ${menuItem.checked}");
           },
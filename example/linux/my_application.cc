@@ -8,6 +8,7 @@
 #include "flutter/generated_plugin_registrant.h"
 
 #include <bitsdojo_window_linux/bitsdojo_window_plugin.h>
+#include <system_tray/system_tray_plugin.h>
 
 struct _MyApplication {
   GtkApplication parent_instance;
@@ -52,7 +53,12 @@ static void my_application_activate(GApplication* application) {
   auto bdw = bitsdojo_window_from(window);
   bdw->setCustomFrame(true);
   // gtk_window_set_default_size(window, 1280, 720);
-  gtk_widget_show(GTK_WIDGET(window));
+  // Launched with --start-hidden, e.g. at login, only the tray is shown.
+  gboolean start_hidden = system_tray_plugin_has_start_hidden_argument(
+      self->dart_entrypoint_arguments);
+  if (!start_hidden) {
+    gtk_widget_show(GTK_WIDGET(window));
+  }
 
   g_autoptr(FlDartProject) project = fl_dart_project_new();
   fl_dart_project_set_dart_entrypoint_arguments(
@@ -64,6 +70,10 @@ static void my_application_activate(GApplication* application) {
 
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
 
+  if (start_hidden) {
+    system_tray_plugin_start_hidden(view);
+  }
+
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
 
@@ -75,6 +85,14 @@ static gboolean my_application_local_command_line(GApplication* application,
   // Strip out the first argument as it is the binary name.
   self->dart_entrypoint_arguments = g_strdupv(*arguments + 1);
 
+  // Hand the launch over to an already running instance, before any engine is
+  // started.
+  if (system_tray_plugin_forward_to_primary_instance(
+          application, self->dart_entrypoint_arguments)) {
+    *exit_status = 0;
+    return TRUE;
+  }
+
   g_autoptr(GError) error = nullptr;
   if (!g_application_register(application, nullptr, &error)) {
     g_warning("Failed to register: %s", error->message);
@@ -107,5 +125,5 @@ static void my_application_init(MyApplication* self) {}
 MyApplication* my_application_new() {
   return MY_APPLICATION(g_object_new(my_application_get_type(),
                                      "application-id", APPLICATION_ID, "flags",
-                                     G_APPLICATION_NON_UNIQUE, nullptr));
+                                     G_APPLICATION_FLAGS_NONE, nullptr));
 }
@@ -1,4 +1,5 @@
 import 'dart:async';
+import 'dart:io';
 
 import 'package:flutter/services.dart';
 
@@ -8,16 +9,130 @@ const String _kInitAppWindow = "InitAppWindow";
 const String _kShowAppWindow = "ShowAppWindow";
 const String _kHideAppWindow = "HideAppWindow";
 const String _kCloseAppWindow = "CloseAppWindow";
+const String _kSetBackgroundMode = "SetBackgroundMode";
+const String _kGetBackgroundStats = "GetBackgroundStats";
+const String _kSetRestoreMode = "SetRestoreMode";
+const String _kGetShowLatency = "GetShowLatency";
+const String _kSetCloseToTray = "SetCloseToTray";
+
+const String _kEnabledKey = "enabled";
+const String _kDelayKey = "delay";
+const String _kActiveKey = "active";
+const String _kRssBeforeKey = "rss_before";
+const String _kRssAfterKey = "rss_after";
+const String _kTrimCountKey = "trim_count";
+const String _kRestoreModeKey = "mode";
+const String _kLastKey = "last";
+const String _kAverageKey = "average";
+const String _kCountKey = "count";
+const String _kArgumentsKey = "arguments";
+const String _kCloseToTrayKey = "close_to_tray";
+const String _kLatencyKey = "latency";
+
+const String _kActivatedCallbackMethod = "ActivatedCallback";
+const String _kCloseRequestedCallbackMethod = "CloseRequestedCallback";
+const String _kFirstShownCallbackMethod = "FirstShownCallback";
+const String _kWindowEventCallbackMethod = "WindowEventCallback";
+
+/// A callback provided to [AppWindow] to handle a forwarded launch.
+typedef AppWindowActivatedCallback = void Function(List<String> arguments);
+
+/// A callback provided to [AppWindow] to handle a close hidden to the tray.
+typedef AppWindowCloseRequestedCallback = void Function();
+
+/// A callback provided to [AppWindow] to handle the first show of a window
+/// started hidden, with the time from [AppWindow.show] to its first frame.
+typedef AppWindowFirstShownCallback = void Function(Duration latency);
+
+/// A callback provided to [AppWindow] to handle window events, one of the
+/// kAppWindowEvent* names.
+typedef AppWindowEventCallback = void Function(String eventName);
+
+/// How the native window is hidden and restored
+enum RestoreMode {
+  /// Unmap the window on hide
+  hide,
+
+  /// Keep the window mapped and move it off-screen on hide, so that it can be
+  /// shown again without a new map and first paint. The window is reported
+  /// unfocused and doesn't receive key events while it is off-screen.
+  ///
+  /// X11 only. On Wayland, and with window managers that keep windows on
+  /// screen such as mutter, the window is unmapped as with [hide].
+  offscreen,
+}
+
+/// Memory statistics of the background mode, see [AppWindow.setBackgroundMode]
+class BackgroundStats {
+  BackgroundStats._fromMap(Map<dynamic, dynamic> map)
+      : enabled = map[_kEnabledKey] ?? false,
+        active = map[_kActiveKey] ?? false,
+        rssBefore = map[_kRssBeforeKey] ?? 0,
+        rssAfter = map[_kRssAfterKey] ?? 0,
+        trimCount = map[_kTrimCountKey] ?? 0;
+
+  /// Whether background mode is enabled
+  final bool enabled;
+
+  /// Whether the app is currently trimmed in background mode
+  final bool active;
+
+  /// Resident set size in bytes right before the last trim
+  final int rssBefore;
+
+  /// Resident set size in bytes right after the last trim
+  final int rssAfter;
+
+  /// Number of times background mode has been entered
+  final int trimCount;
+}
+
+String _restoreModeName(RestoreMode mode) {
+  return mode.toString().split('.').last;
+}
+
+/// Time from [AppWindow.show] to the first frame drawn afterwards
+class ShowLatency {
+  ShowLatency._fromMap(Map<dynamic, dynamic> map)
+      : mode = RestoreMode.values.firstWhere(
+            (e) => _restoreModeName(e) == map[_kRestoreModeKey],
+            orElse: () => RestoreMode.hide),
+        last = Duration(microseconds: map[_kLastKey] ?? 0),
+        average = Duration(microseconds: map[_kAverageKey] ?? 0),
+        count = map[_kCountKey] ?? 0;
+
+  /// The restore mode currently in use
+  final RestoreMode mode;
+
+  /// Latency of the last show
+  final Duration last;
+
+  /// Average latency over all measured shows
+  final Duration average;
+
+  /// Number of measured shows
+  final int count;
+}
 
 /// Representation of native window
 class AppWindow {
-  AppWindow() {
+  /// With [closeToTray] (Linux), closing the window hides it instead, see
+  /// [setCloseToTray].
+  AppWindow({bool closeToTray = false}) {
     _platformChannel.setMethodCallHandler(_callbackHandler);
-    _init();
+    _init(closeToTray);
   }
 
   static const MethodChannel _platformChannel = MethodChannel(_kChannelName);
 
+  AppWindowActivatedCallback? _activatedCallback;
+
+  AppWindowCloseRequestedCallback? _closeRequestedCallback;
+
+  AppWindowFirstShownCallback? _firstShownCallback;
+
+  AppWindowEventCallback? _windowEventCallback;
+
   /// Show native window
   Future<void> show() async {
     await _platformChannel.invokeMethod(_kShowAppWindow);
@@ -29,13 +144,136 @@ class AppWindow {
   }
 
   /// Close native window
+  ///
+  /// Closes it even in close-to-tray mode, so use it to quit.
   Future<void> close() async {
     await _platformChannel.invokeMethod(_kCloseAppWindow);
   }
 
-  void _init() async {
-    await _platformChannel.invokeMethod(_kInitAppWindow);
+  /// (Linux) Enable or disable background mode.
+  ///
+  /// Once the window has been hidden for [delay], caches held by the
+  /// framework are released and the freed heap is returned to the OS.
+  /// Showing the window leaves background mode.
+  Future<void> setBackgroundMode({
+    required bool enabled,
+    Duration delay = const Duration(seconds: 30),
+  }) async {
+    if (!Platform.isLinux) {
+      return;
+    }
+
+    await _platformChannel.invokeMethod(_kSetBackgroundMode, <String, dynamic>{
+      _kEnabledKey: enabled,
+      _kDelayKey: delay.inMilliseconds,
+    });
+  }
+
+  /// (Linux) Returns the memory statistics of the background mode
+  Future<BackgroundStats?> getBackgroundStats() async {
+    if (!Platform.isLinux) {
+      return null;
+    }
+
+    final Map<dynamic, dynamic> stats =
+        await _platformChannel.invokeMethod(_kGetBackgroundStats);
+    return BackgroundStats._fromMap(stats);
+  }
+
+  /// (Linux) Sets how the window is hidden and restored
+  Future<void> setRestoreMode(RestoreMode mode) async {
+    if (!Platform.isLinux) {
+      return;
+    }
+
+    await _platformChannel.invokeMethod(_kSetRestoreMode, <String, dynamic>{
+      _kRestoreModeKey: _restoreModeName(mode),
+    });
+  }
+
+  /// (Linux) Returns the measured latency of [show]
+  Future<ShowLatency?> getShowLatency() async {
+    if (!Platform.isLinux) {
+      return null;
+    }
+
+    final Map<dynamic, dynamic> latency =
+        await _platformChannel.invokeMethod(_kGetShowLatency);
+    return ShowLatency._fromMap(latency);
+  }
+
+  /// (Linux) Enable or disable close-to-tray mode.
+  ///
+  /// While enabled, closing the window from its title bar or the window
+  /// manager hides it as [hide] does and calls the handler registered with
+  /// [registerCloseRequestedHandler]. The engine keeps running, so [show]
+  /// brings it back without a cold start. [close] still closes it.
+  Future<void> setCloseToTray({required bool enabled}) async {
+    if (!Platform.isLinux) {
+      return;
+    }
+
+    await _platformChannel.invokeMethod(_kSetCloseToTray, <String, dynamic>{
+      _kEnabledKey: enabled,
+    });
+  }
+
+  void _init(bool closeToTray) async {
+    // The window may be closed before setCloseToTray could be called, so the
+    // initial mode is set along with the window.
+    await _platformChannel.invokeMethod(
+        _kInitAppWindow,
+        closeToTray && Platform.isLinux
+            ? <String, dynamic>{_kCloseToTrayKey: true}
+            : null);
   }
 
-  Future<void> _callbackHandler(MethodCall methodCall) async {}
+  /// (Linux) Register listener for launches forwarded by another instance.
+  ///
+  /// Requires the runner to call
+  /// `system_tray_plugin_forward_to_primary_instance`.
+  void registerActivatedHandler(AppWindowActivatedCallback callback) {
+    _activatedCallback = callback;
+  }
+
+  /// (Linux) Register listener for the window being hidden instead of closed
+  /// in close-to-tray mode.
+  void registerCloseRequestedHandler(AppWindowCloseRequestedCallback callback) {
+    _closeRequestedCallback = callback;
+  }
+
+  /// (Linux) Register listener for the first [show] of a window started
+  /// hidden having been drawn.
+  ///
+  /// Requires the runner to call `system_tray_plugin_start_hidden` instead of
+  /// showing the window.
+  void registerFirstShownHandler(AppWindowFirstShownCallback callback) {
+    _firstShownCallback = callback;
+  }
+
+  /// (Linux) Register listener for the window being shown or hidden,
+  /// iconified or deiconified, focused or unfocused.
+  ///
+  /// Events are only sent when the state changes, so apps can pause work
+  /// while the window is away instead of polling.
+  void registerWindowEventHandler(AppWindowEventCallback callback) {
+    _windowEventCallback = callback;
+  }
+
+  Future<void> _callbackHandler(MethodCall methodCall) async {
+    if (methodCall.method == _kActivatedCallbackMethod) {
+      if (_activatedCallback != null) {
+        final List<String> arguments =
+            List<String>.from(methodCall.arguments[_kArgumentsKey] ?? []);
+        _activatedCallback!(arguments);
+      }
+    } else if (methodCall.method == _kCloseRequestedCallbackMethod) {
+      _closeRequestedCallback?.call();
+    } else if (methodCall.method == _kWindowEventCallbackMethod) {
+      _windowEventCallback?.call(methodCall.arguments as String);
+    } else if (methodCall.method == _kFirstShownCallbackMethod) {
+      _firstShownCallback?.call(Duration(
+          microseconds: methodCall.arguments[_kLatencyKey] as int? ?? 0));
+    }
+  }
 }
@@ -2,3 +2,11 @@
 const String kSystemTrayEventClick = "click";
 const String kSystemTrayEventRightClick = "right-click";
 const String kSystemTrayEventDoubleClick = "double-click";
+
+/// [AppWindow] event name
+const String kAppWindowEventShown = "shown";
+const String kAppWindowEventHidden = "hidden";
+const String kAppWindowEventIconified = "iconified";
+const String kAppWindowEventDeiconified = "deiconified";
+const String kAppWindowEventFocused = "focused";
+const String kAppWindowEventUnfocused = "unfocused";
@@ -1,3 +1,6 @@
+import 'dart:async';
+import 'dart:isolate';
+
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
 
@@ -11,9 +14,115 @@ const String _kCreateContextMenu = "CreateContextMenu";
 const String _kMenuIdKey = 'menu_id';
 const String _kMenuItemIdKey = 'menu_item_id';
 const String _kMenuListKey = 'menu_list';
+const String _kGenerationKey = 'generation';
+const String _kCheckedKey = 'checked';
+const String _kDeferUpdatesKey = 'defer_updates';
+
+/// The number of menu generations whose clicks are still resolved.
+const int _kMaxGenerations = 8;
 
 const String _kMenuItemSelectedCallbackMethod = 'MenuItemSelectedCallback';
 
+/// Encodes the CreateContextMenu call for a menu flattened by
+/// [menuListToFlat]. Runs on the [_MenuEncoder] isolate.
+TransferableTypedData _encodeCreateContextMenu(List<Object?> message) {
+  final int menuId = message[0] as int;
+  final int generation = message[1] as int;
+  final List<Object?> flat = message[2] as List<Object?>;
+  final bool deferUpdates = message[3] as bool;
+
+  final List<Map<String, dynamic>> menuList = [];
+  menuListFromFlat(flat, 0, menuList);
+
+  final ByteData data = const StandardMethodCodec().encodeMethodCall(
+      MethodCall(_kCreateContextMenu, <String, dynamic>{
+    _kMenuIdKey: menuId,
+    _kGenerationKey: generation,
+    if (deferUpdates) _kDeferUpdatesKey: true,
+    _kMenuListKey: menuList,
+  }));
+  return TransferableTypedData.fromList(
+      [data.buffer.asUint8List(data.offsetInBytes, data.lengthInBytes)]);
+}
+
+/// Entry point of the [_MenuEncoder] isolate.
+void _menuEncoderMain(SendPort replies) {
+  final ReceivePort requests = ReceivePort();
+  replies.send(requests.sendPort);
+
+  requests.listen((Object? message) {
+    final List<Object?> request = message as List<Object?>;
+    final int requestId = request[0] as int;
+    try {
+      replies.send(<Object?>[
+        requestId,
+        _encodeCreateContextMenu(request[1] as List<Object?>),
+      ]);
+    } catch (e) {
+      replies.send(<Object?>[requestId, e.toString()]);
+    }
+  });
+}
+
+/// A background isolate that encodes the menus built with
+/// [Menu.serializeInBackground].
+///
+/// It is spawned by the first such build and kept for the following ones.
+class _MenuEncoder {
+  _MenuEncoder._();
+
+  static final _MenuEncoder instance = _MenuEncoder._();
+
+  /// The port of the isolate, once it has started.
+  Future<SendPort>? _requests;
+
+  /// The pending requests, by request id.
+  final Map<int, Completer<TransferableTypedData>> _pending = {};
+
+  int _nextRequestId = 1;
+
+  Future<SendPort> _start() {
+    final Completer<SendPort> started = Completer<SendPort>();
+    final RawReceivePort replies = RawReceivePort();
+    replies.handler = (Object? message) {
+      if (message is SendPort) {
+        started.complete(message);
+        return;
+      }
+
+      final List<Object?> reply = message as List<Object?>;
+      final Completer<TransferableTypedData>? completer =
+          _pending.remove(reply[0] as int);
+      final Object? result = reply[1];
+      if (result is TransferableTypedData) {
+        completer?.complete(result);
+      } else {
+        completer?.completeError(StateError('$result'));
+      }
+    };
+
+    Isolate.spawn(_menuEncoderMain, replies.sendPort,
+            debugName: 'menu encoder')
+        .then((_) {}, onError: (Object error, StackTrace stackTrace) {
+      replies.close();
+      _requests = null;
+      started.completeError(error, stackTrace);
+    });
+    return started.future;
+  }
+
+  /// Encodes the arguments of [_encodeCreateContextMenu] on the isolate.
+  Future<TransferableTypedData> encode(List<Object?> message) async {
+    final SendPort requests = await (_requests ??= _start());
+    final int requestId = _nextRequestId++;
+    final Completer<TransferableTypedData> completer =
+        Completer<TransferableTypedData>();
+    _pending[requestId] = completer;
+    requests.send(<Object?>[requestId, message]);
+    return completer.future;
+  }
+}
+
 class Menu {
   static const MethodChannel _platformChannel = MethodChannel(_kChannelName);
 
@@ -28,9 +137,33 @@ class Menu {
 
   int _menuItemId = 1;
 
-  bool _updateInProgress = false;
+  /// Incremented for every native menu created from this menu.
+  int _generation = 0;
+
+  /// The items of the most recent generations, by menu item id. Clicks carry
+  /// the generation of the native menu they come from, so they resolve to the
+  /// item as it was in that generation even while the menu is being rebuilt.
+  final Map<int, Map<int, MenuItemBase>> _generations = {};
 
-  Menu() {
+  /// Whether the menu is serialized on a background isolate.
+  ///
+  /// Recommended for menus with thousands of items, so building them doesn't
+  /// block the UI isolate. Only the fields of the items are sent there; the
+  /// isolate is started once and shared by all menus.
+  final bool serializeInBackground;
+
+  /// Whether item updates are only applied once the menu is about to be
+  /// shown, keeping just the latest value of each item while it is closed.
+  ///
+  /// Recommended for items that show live values and change many times a
+  /// second. Linux only. The updates are applied when the panel announces
+  /// that it opens the menu (dbusmenu's about-to-show); with indicators that
+  /// can't tell, they are applied once a second instead.
+  final bool deferUpdatesWhileClosed;
+
+  Menu(
+      {this.serializeInBackground = false,
+      this.deferUpdatesWhileClosed = false}) {
     _platformChannel.setMethodCallHandler(_callbackHandler);
   }
 
@@ -68,76 +201,121 @@ class Menu {
     return item;
   }
 
-  MenuItemBase? _findItemById(
-      final int? menuItemId, final List<MenuItemBase>? menus) {
-    MenuItemBase? item;
-    if (menuItemId != null && menus != null) {
-      for (final menuItem in menus) {
-        if (menuItem is SubMenu) {
-          item = _findItemById(menuItemId, menuItem.children);
-        } else if (menuItem.menuItemId == menuItemId) {
-          item = menuItem;
-        }
-
-        if (item != null) {
-          break;
-        }
-      }
-    }
-    return item;
-  }
-
   Future<bool> _createContextMenu(List<MenuItemBase> menus) async {
     bool result = false;
     try {
-      _updateInProgress = true;
+      final int generation = ++_generation;
+      final Map<int, MenuItemBase> items = {};
+      final List<Object?>? flat = serializeInBackground ? [] : null;
+      await _channelRepresentationForMenus(menus, items, flat);
 
-      await _channelRepresentationForMenus(menus);
+      _generations[generation] = items;
+      _generations.remove(generation - _kMaxGenerations);
 
-      result = await _platformChannel
-          .invokeMethod(_kCreateContextMenu, <String, dynamic>{
-        _kMenuIdKey: _menuId,
-        _kMenuListKey: menus.map((e) => e.toJson()).toList(),
-      });
-      _updateInProgress = false;
+      if (flat != null) {
+        result = await _createContextMenuInBackground(flat, generation);
+      } else {
+        result = await _platformChannel
+            .invokeMethod(_kCreateContextMenu, <String, dynamic>{
+          _kMenuIdKey: _menuId,
+          _kGenerationKey: generation,
+          if (deferUpdatesWhileClosed) _kDeferUpdatesKey: true,
+          _kMenuListKey: menus.map((e) => e.toJson()).toList(),
+        });
+      }
     } on PlatformException catch (e) {
       debugPrint('Platform exception create context menu: ${e.message}');
     }
     return result;
   }
 
-  Future<void> _channelRepresentationForMenus(List<MenuItemBase> menus) async {
+  /// Sends the CreateContextMenu call for [flat], the menu flattened by
+  /// [_channelRepresentationForMenus], encoded on the [_MenuEncoder].
+  Future<bool> _createContextMenuInBackground(
+      List<Object?> flat, int generation) async {
+    final TransferableTypedData payload;
+    try {
+      payload = await _MenuEncoder.instance.encode(
+          <Object?>[_menuId, generation, flat, deferUpdatesWhileClosed]);
+    } catch (e) {
+      // Fails the build like an error of the platform side would, as in the
+      // foreground.
+      throw PlatformException(code: 'EncodeError', message: '$e');
+    }
+
+    final ByteData? reply = await _platformChannel.binaryMessenger
+        .send(_kChannelName, payload.materialize().asByteData());
+    if (reply == null) {
+      throw MissingPluginException(
+          'No implementation found for method $_kCreateContextMenu on channel $_kChannelName');
+    }
+    return _platformChannel.codec.decodeEnvelope(reply) as bool;
+  }
+
+  /// Resolved icon paths by image. Resolving an icon can copy it out of the
+  /// assets, so each is only resolved once.
+  static final Map<String, String?> _iconPaths = {};
+
+  static FutureOr<String?> _resolveIcon(String? image) {
+    if (image == null) {
+      return null;
+    }
+    if (_iconPaths.containsKey(image)) {
+      return _iconPaths[image];
+    }
+    return Utils.getIcon(image).then((path) => _iconPaths[image] = path);
+  }
+
+  /// Assigns the ids of [menus], and flattens them into [flat] like
+  /// [menuListToFlat] if it is given.
+  Future<void> _channelRepresentationForMenus(List<MenuItemBase> menus,
+      Map<int, MenuItemBase> items, List<Object?>? flat) async {
     _menuItemId = 1;
-    await _channelRepresentationForMenu(menus);
+    await _channelRepresentationForMenu(menus, items, flat);
   }
 
-  Future<void> _channelRepresentationForMenu(List<MenuItemBase> menus) async {
+  Future<void> _channelRepresentationForMenu(List<MenuItemBase> menus,
+      Map<int, MenuItemBase> items, List<Object?>? flat) async {
+    assignRadioGroups(menus);
+    flat?.add(menus.length);
     for (final menuItem in menus) {
       menuItem.channel = _platformChannel;
       menuItem.menuId = menuId;
       menuItem.menuItemId = nextMenuItemId;
-      menuItem.imageAbsolutePath = await Utils.getIcon(menuItem.image);
+      final FutureOr<String?> icon = _resolveIcon(menuItem.image);
+      menuItem.imageAbsolutePath = icon is Future<String?> ? await icon : icon;
+      items[menuItem.menuItemId!] = menuItem;
+      if (flat != null) {
+        menuItem.toFlat(flat);
+      }
 
       if (menuItem is SubMenu) {
-        await _channelRepresentationForMenu(menuItem.children);
+        await _channelRepresentationForMenu(menuItem.children, items, flat);
       }
     }
   }
 
   Future<void> _callbackHandler(MethodCall methodCall) async {
     if (methodCall.method == _kMenuItemSelectedCallbackMethod) {
-      if (_updateInProgress) {
-        debugPrint(
-            'Warning: Menu selection callback received during menu update.');
-        return;
-      }
-
       final int? menuId = methodCall.arguments[_kMenuIdKey];
       final int? menuItemId = methodCall.arguments[_kMenuItemIdKey];
+      final Menu? menu = _menuMap[menuId];
+
+      // Platforms that don't report the generation get the latest one.
+      final int? generation =
+          methodCall.arguments[_kGenerationKey] ?? menu?._generation;
       final MenuItemBase? menuItem =
-          _findItemById(menuItemId, _menuMap[menuId]?._menus);
+          menu?._generations[generation]?[menuItemId];
+
+      debugPrint(
+          'MenuItemBase select menuId:$menuId menuItemId:$menuItemId generation:$generation');
 
-      debugPrint('MenuItemBase select menuId:$menuId menuItemId:$menuItemId');
+      // Checkboxes and radio items are toggled natively, which reports their
+      // new state along with the click.
+      final bool? checked = methodCall.arguments[_kCheckedKey];
+      if (menuItem != null && checked != null) {
+        menuItem.applyChecked(checked);
+      }
 
       final callback = menuItem?.onClicked;
       if (callback != null) {
@@ -14,11 +14,38 @@ const String _kMenuTypeLabel = 'label';
 const String _kMenuTypeCheckbox = 'checkbox';
 const String _kMenuTypeSubMenu = 'submenu';
 const String _kMenuTypeSeparator = 'separator';
+const String _kMenuTypeRadio = 'radio';
 const String _kLabelKey = 'label';
 const String _kImageKey = 'image';
 const String _kSubMenuKey = 'submenu';
 const String _kEnabledKey = 'enabled';
 const String _kCheckedKey = 'checked';
+const String _kNativeActionKey = 'native_action';
+
+/// (Linux) Actions a menu item can run natively when it is clicked, before
+/// [MenuItemBase.onClicked] is called.
+///
+/// They don't wait for the Dart isolate, so they respond even while it is
+/// busy.
+enum NativeMenuAction {
+  showAppWindow,
+  hideAppWindow,
+  toggleAppWindow,
+  closeAppWindow,
+}
+
+String _nativeActionName(NativeMenuAction action) {
+  switch (action) {
+    case NativeMenuAction.showAppWindow:
+      return 'show_app_window';
+    case NativeMenuAction.hideAppWindow:
+      return 'hide_app_window';
+    case NativeMenuAction.toggleAppWindow:
+      return 'toggle_app_window';
+    case NativeMenuAction.closeAppWindow:
+      return 'close_app_window';
+  }
+}
 
 /// A callback provided to [MenuItemBase] to handle menu selection.
 typedef MenuItemSelectedCallback = void Function(MenuItemBase);
@@ -32,11 +59,33 @@ abstract class MenuItemBase {
     this.name,
     this.enabled,
     this.checked,
-    this.onClicked,
-  );
+    this.onClicked, [
+    this.nativeAction,
+  ]);
 
   Map<String, dynamic> toJson() {
-    return <String, dynamic>{};
+    return menuItemJson(type, menuItemId, label, imageAbsolutePath, enabled,
+        checked, _platformNativeAction);
+  }
+
+  /// The name of [nativeAction] sent to the platform, if there is one.
+  String? get _platformNativeAction =>
+      nativeAction != null ? _nativeActionName(nativeAction!) : null;
+
+  /// Appends the fields [toJson] reads to [out], see [menuListFromFlat].
+  /// The children of a [SubMenu] are appended by [menuListToFlat].
+  ///
+  /// Unlike the item itself, the flat list only holds primitive values and
+  /// can be sent to another isolate.
+  void toFlat(List<Object?> out) {
+    out
+      ..add(type)
+      ..add(menuItemId)
+      ..add(label)
+      ..add(imageAbsolutePath)
+      ..add(enabled)
+      ..add(checked)
+      ..add(_platformNativeAction);
   }
 
   Future<void> setLabel(String label) async {
@@ -76,7 +125,7 @@ abstract class MenuItemBase {
   }
 
   Future<void> setCheck(bool checked) async {
-    if (type != _kMenuTypeCheckbox) {
+    if (type != _kMenuTypeCheckbox && type != _kMenuTypeRadio) {
       return;
     }
 
@@ -86,10 +135,16 @@ abstract class MenuItemBase {
       _kCheckedKey: checked,
     });
     if (result) {
-      this.checked = checked;
+      applyChecked(checked);
     }
   }
 
+  /// Records [checked] as the state of the item, e.g. when it was toggled
+  /// natively by a click.
+  void applyChecked(bool checked) {
+    this.checked = checked;
+  }
+
   MethodChannel? channel;
   int? menuId;
   int? menuItemId;
@@ -108,6 +163,9 @@ abstract class MenuItemBase {
 
   /// The callback to call whenever the menu item is selected.
   final MenuItemSelectedCallback? onClicked;
+
+  /// (Linux) The action to run natively when the menu item is selected.
+  final NativeMenuAction? nativeAction;
 }
 
 /// A standard menu item, with no submenus.
@@ -118,18 +176,9 @@ class MenuItemLabel extends MenuItemBase {
     String? name,
     bool enabled = true,
     MenuItemSelectedCallback? onClicked,
-  }) : super(_kMenuTypeLabel, label, image, name, enabled, false, onClicked);
-
-  @override
-  Map<String, dynamic> toJson() {
-    return <String, dynamic>{
-      _kTypeKey: type,
-      _kIdKey: menuItemId,
-      _kLabelKey: label,
-      _kImageKey: imageAbsolutePath,
-      _kEnabledKey: enabled,
-    };
-  }
+    NativeMenuAction? nativeAction,
+  }) : super(_kMenuTypeLabel, label, image, name, enabled, false, onClicked,
+            nativeAction);
 }
 
 /// A menu item that serves as a checkbox.
@@ -141,22 +190,75 @@ class MenuItemCheckbox extends MenuItemBase {
     bool enabled = true,
     bool checked = false,
     MenuItemSelectedCallback? onClicked,
+    NativeMenuAction? nativeAction,
   }) : super(_kMenuTypeCheckbox, label, image, name, enabled, checked,
-            onClicked);
+            onClicked, nativeAction);
+}
+
+/// A menu item that is checked exclusively of the radio items next to it.
+///
+/// On macOS the checked item shows a check mark.
+///
+/// Adjacent radio items of the same menu form a group. Exactly one item of a
+/// group is checked: the last one created with [checked] set, or else the
+/// first one. Clicking an item checks it natively, and [checked] is updated
+/// before [onClicked] is called.
+class MenuItemRadio extends MenuItemBase {
+  MenuItemRadio({
+    required String label,
+    String? image,
+    String? name,
+    bool enabled = true,
+    bool checked = false,
+    MenuItemSelectedCallback? onClicked,
+    NativeMenuAction? nativeAction,
+  }) : super(_kMenuTypeRadio, label, image, name, enabled, checked, onClicked,
+            nativeAction);
+
+  /// The items of the group, this one included. Assigned when the menu is
+  /// built.
+  List<MenuItemRadio> group = const [];
 
   @override
-  Map<String, dynamic> toJson() {
-    return <String, dynamic>{
-      _kTypeKey: type,
-      _kIdKey: menuItemId,
-      _kLabelKey: label,
-      _kImageKey: imageAbsolutePath,
-      _kEnabledKey: enabled,
-      _kCheckedKey: checked,
-    };
+  void applyChecked(bool checked) {
+    if (!checked) {
+      return;
+    }
+    for (final item in group) {
+      item.checked = false;
+    }
+    this.checked = true;
   }
 }
 
+/// Assigns the radio groups of [menus], not of its submenus, and leaves one
+/// item of each checked the way the platforms show them.
+void assignRadioGroups(List<MenuItemBase> menus) {
+  List<MenuItemRadio> group = [];
+
+  void endGroup() {
+    if (group.isEmpty) {
+      return;
+    }
+    final MenuItemRadio checked =
+        group.lastWhere((item) => item.checked, orElse: () => group.first);
+    for (final item in group) {
+      item.group = group;
+      item.checked = identical(item, checked);
+    }
+    group = [];
+  }
+
+  for (final menuItem in menus) {
+    if (menuItem is MenuItemRadio) {
+      group.add(menuItem);
+    } else {
+      endGroup();
+    }
+  }
+  endGroup();
+}
+
 /// A menu item continaing a submenu.
 ///
 /// The item itself can't be selected, it just displays the submenu.
@@ -167,14 +269,10 @@ class SubMenu extends MenuItemBase {
 
   @override
   Map<String, dynamic> toJson() {
-    return <String, dynamic>{
-      _kTypeKey: type,
-      _kIdKey: menuItemId,
-      _kLabelKey: label,
-      _kImageKey: imageAbsolutePath,
-      _kEnabledKey: enabled,
-      _kSubMenuKey: children.map((e) => e.toJson()).toList(),
-    };
+    return menuItemJson(type, menuItemId, label, imageAbsolutePath, enabled,
+        checked, _platformNativeAction, [
+      for (final child in children) child.toJson(),
+    ]);
   }
 
   /// The menu items contained in the submenu.
@@ -186,11 +284,68 @@ class MenuSeparator extends MenuItemBase {
   /// Creates a new separator item.
   MenuSeparator()
       : super(_kMenuTypeSeparator, '', null, null, true, false, null);
+}
 
-  @override
-  Map<String, dynamic> toJson() {
-    return <String, dynamic>{
-      _kTypeKey: type,
-    };
+/// The `toJson()` representation of a menu item, shared by the items and
+/// [menuListFromFlat].
+Map<String, dynamic> menuItemJson(String type, Object? id, Object? label,
+    Object? image, Object? enabled, Object? checked, Object? nativeAction,
+    [List<Map<String, dynamic>>? children]) {
+  if (type == _kMenuTypeSeparator) {
+    return <String, dynamic>{_kTypeKey: type};
+  }
+
+  final Map<String, dynamic> json = <String, dynamic>{
+    _kTypeKey: type,
+    _kIdKey: id,
+    _kLabelKey: label,
+    _kImageKey: image,
+    _kEnabledKey: enabled,
+  };
+  if (type == _kMenuTypeCheckbox || type == _kMenuTypeRadio) {
+    json[_kCheckedKey] = checked;
+  }
+  if (children != null) {
+    json[_kSubMenuKey] = children;
+  }
+  if (nativeAction != null) {
+    json[_kNativeActionKey] = nativeAction;
+  }
+  return json;
+}
+
+/// Flattens [menus] into [out], for [menuListFromFlat].
+void menuListToFlat(List<MenuItemBase> menus, List<Object?> out) {
+  out.add(menus.length);
+  for (final menuItem in menus) {
+    menuItem.toFlat(out);
+    if (menuItem is SubMenu) {
+      menuListToFlat(menuItem.children, out);
+    }
+  }
+}
+
+/// Rebuilds the `toJson()` representation of a menu list flattened by
+/// [menuListToFlat], starting at [offset]. Returns the offset past it.
+int menuListFromFlat(
+    List<Object?> flat, int offset, List<Map<String, dynamic>> out) {
+  final int length = flat[offset++] as int;
+  for (int i = 0; i < length; ++i) {
+    final String type = flat[offset++] as String;
+    final Object? id = flat[offset++];
+    final Object? label = flat[offset++];
+    final Object? image = flat[offset++];
+    final Object? enabled = flat[offset++];
+    final Object? checked = flat[offset++];
+    final Object? nativeAction = flat[offset++];
+
+    List<Map<String, dynamic>>? children;
+    if (type == _kMenuTypeSubMenu) {
+      children = [];
+      offset = menuListFromFlat(flat, offset, children);
+    }
+    out.add(menuItemJson(
+        type, id, label, image, enabled, checked, nativeAction, children));
   }
+  return offset;
 }
@@ -1,4 +1,6 @@
 import 'dart:async';
+import 'dart:io';
+import 'dart:typed_data';
 
 import 'package:flutter/services.dart';
 import 'package:uuid/uuid.dart';
@@ -14,6 +16,9 @@ const String _kSetContextMenu = "SetContextMenu";
 const String _kPopupContextMenu = "PopupContextMenu";
 const String _kGetTitle = "GetTitle";
 const String _kDestroySystemTray = "DestroySystemTray";
+const String _kSetImageFrame = "SetImageFrame";
+const String _kRegisterTrayStates = "RegisterTrayStates";
+const String _kSetTrayState = "SetTrayState";
 
 const String _kSystemTrayEventCallbackMethod = 'SystemTrayEventCallback';
 
@@ -22,10 +27,45 @@ const String _kTitleKey = "title";
 const String _kIconPathKey = "iconpath";
 const String _kToolTipKey = "tooltip";
 const String _kIsTemplateKey = "is_template";
+const String _kWidthKey = "width";
+const String _kHeightKey = "height";
+const String _kRgbaKey = "rgba";
+const String _kNameKey = "name";
+const String _kStatusKey = "status";
+const String _kRestoreOnLaunchKey = "restore_on_launch";
 
 /// A callback provided to [SystemTray] to handle system tray click event.
 typedef SystemTrayEventCallback = void Function(String eventName);
 
+/// Status of the tray icon, see [TrayState]
+enum TrayStatus {
+  /// The icon is shown
+  active,
+
+  /// The icon is shown and asks for attention. On Linux the icon of an
+  /// attention state becomes the indicator's attention icon.
+  attention,
+
+  /// The icon is hidden (Linux only)
+  passive,
+}
+
+/// A named tray appearance, see [SystemTray.registerTrayStates]
+class TrayState {
+  TrayState({
+    required this.iconPath,
+    this.title,
+    this.status = TrayStatus.active,
+  });
+
+  final String iconPath;
+
+  /// The label next to the icon. Switching to a state without one clears
+  /// the label.
+  final String? title;
+  final TrayStatus status;
+}
+
 /// Representation of system tray
 class SystemTray {
   SystemTray() {
@@ -37,12 +77,22 @@ class SystemTray {
   ///
   SystemTrayEventCallback? _systemTrayEventCallback;
 
+  /// States registered with [registerTrayStates], for platforms that switch
+  /// them through [setSystemTrayInfo].
+  Map<String, TrayState> _trayStates = {};
+
   /// Show a SystemTray icon
+  ///
+  /// With [restoreOnLaunch] (Linux), the tray and its context menu are saved
+  /// and shown again at the next launch while the engine is still starting.
+  /// Clicks on it are delivered once the context menu is set again. The
+  /// restored tray is removed if this isn't called within a few seconds.
   Future<bool> initSystemTray({
     required String iconPath,
     String? title,
     String? toolTip,
     bool isTemplate = false,
+    bool restoreOnLaunch = false,
   }) async {
     bool value = await _platformChannel.invokeMethod(
       _kInitSystemTray,
@@ -52,6 +102,7 @@ class SystemTray {
         _kIconPathKey: await Utils.getIcon(iconPath),
         _kToolTipKey: toolTip,
         _kIsTemplateKey: isTemplate,
+        if (restoreOnLaunch) _kRestoreOnLaunchKey: true,
       },
     );
     return value;
@@ -81,6 +132,75 @@ class SystemTray {
     await setSystemTrayInfo(iconPath: image, isTemplate: isTemplate);
   }
 
+  /// (Linux) Sets the tray image from raw, non-premultiplied RGBA pixels.
+  ///
+  /// Meant for icons redrawn many times per second: only the latest frame is
+  /// kept natively, and frames arriving faster than the panel is updated are
+  /// dropped.
+  Future<bool> setImageFrame({
+    required int width,
+    required int height,
+    required Uint8List rgba,
+  }) async {
+    if (!Platform.isLinux) {
+      return false;
+    }
+
+    assert(rgba.length == width * height * 4);
+
+    bool value = await _platformChannel.invokeMethod(
+      _kSetImageFrame,
+      <String, dynamic>{
+        _kWidthKey: width,
+        _kHeightKey: height,
+        _kRgbaKey: rgba,
+      },
+    );
+    return value;
+  }
+
+  /// Registers the named [states] the tray can switch between with
+  /// [setTrayState].
+  ///
+  /// On Linux the icons are handed to the native side once, so a switch
+  /// doesn't reload the icon.
+  Future<bool> registerTrayStates(Map<String, TrayState> states) async {
+    _trayStates = Map<String, TrayState>.from(states);
+
+    if (!Platform.isLinux) {
+      return true;
+    }
+
+    final List<Map<String, dynamic>> stateList = [];
+    for (final entry in states.entries) {
+      stateList.add(<String, dynamic>{
+        _kNameKey: entry.key,
+        _kIconPathKey: await Utils.getIcon(entry.value.iconPath),
+        _kTitleKey: entry.value.title,
+        _kStatusKey: entry.value.status.toString().split('.').last,
+      });
+    }
+
+    bool value =
+        await _platformChannel.invokeMethod(_kRegisterTrayStates, stateList);
+    return value;
+  }
+
+  /// Switches to a state registered with [registerTrayStates].
+  Future<bool> setTrayState(String name) async {
+    if (!Platform.isLinux) {
+      final TrayState? state = _trayStates[name];
+      if (state == null) {
+        return false;
+      }
+      return await setSystemTrayInfo(
+          iconPath: state.iconPath, title: state.title ?? '');
+    }
+
+    bool value = await _platformChannel.invokeMethod(_kSetTrayState, name);
+    return value;
+  }
+
   /// (Windows\macOS) Sets the hover text for this tray icon.
   Future<void> setToolTip(String toolTip) async {
     await setSystemTrayInfo(toolTip: toolTip);
@@ -107,6 +227,8 @@ class SystemTray {
 
   /// Pop up the context menu.
   ///
+  /// (Linux) Outside of a click on the window, the menu can only be shown at
+  /// the pointer on X11; on Wayland nothing is shown.
   Future<void> popUpContextMenu() async {
     await _platformChannel.invokeMethod(_kPopupContextMenu);
   }
@@ -4,6 +4,8 @@ import 'dart:io';
 import 'package:flutter/services.dart';
 import 'package:path/path.dart' show dirname, joinAll;
 
+const String _kResourceScheme = 'resource://';
+
 class Utils {
   static Future<String?> getIcon(String? assetPath) async {
     if (assetPath == null) {
@@ -14,6 +16,11 @@ class Utils {
       return '';
     }
 
+    // (Linux) Icons compiled into the plugin with SYSTEM_TRAY_ICON_RESOURCES.
+    if (Platform.isLinux && assetPath.startsWith(_kResourceScheme)) {
+      return assetPath;
+    }
+
     if (Platform.isMacOS) {
       return await base64Image(assetPath);
     }
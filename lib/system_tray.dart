@@ -1,5 +1,6 @@
 export 'src/tray.dart';
 export 'src/app_window.dart';
 export 'src/menu.dart';
-export 'src/menu_item.dart';
+export 'src/menu_item.dart'
+    hide menuListToFlat, menuListFromFlat, menuItemJson, assignRadioGroups;
 export 'src/constants.dart';
@@ -1,12 +1,82 @@
 #include "app_window.h"
 
 #include <gdk/gdk.h>
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 #include "errors.h"
+#include "utils.h"
 
 constexpr char kInitAppWindow[] = "InitAppWindow";
 constexpr char kShowAppWindow[] = "ShowAppWindow";
 constexpr char kHideAppWindow[] = "HideAppWindow";
 constexpr char kCloseAppWindow[] = "CloseAppWindow";
+constexpr char kSetBackgroundMode[] = "SetBackgroundMode";
+constexpr char kGetBackgroundStats[] = "GetBackgroundStats";
+constexpr char kSetRestoreMode[] = "SetRestoreMode";
+constexpr char kGetShowLatency[] = "GetShowLatency";
+constexpr char kSetCloseToTray[] = "SetCloseToTray";
+
+namespace {
+
+constexpr char kEnabledKey[] = "enabled";
+constexpr char kDelayKey[] = "delay";
+constexpr char kActiveKey[] = "active";
+constexpr char kRssBeforeKey[] = "rss_before";
+constexpr char kRssAfterKey[] = "rss_after";
+constexpr char kTrimCountKey[] = "trim_count";
+constexpr char kArgumentsKey[] = "arguments";
+constexpr char kRestoreModeKey[] = "mode";
+constexpr char kRestoreModeHide[] = "hide";
+constexpr char kRestoreModeOffscreen[] = "offscreen";
+constexpr char kLastKey[] = "last";
+constexpr char kAverageKey[] = "average";
+constexpr char kCountKey[] = "count";
+constexpr char kCloseToTrayKey[] = "close_to_tray";
+constexpr char kLatencyKey[] = "latency";
+
+constexpr char kActivatedCallbackMethod[] = "ActivatedCallback";
+constexpr char kCloseRequestedCallbackMethod[] = "CloseRequestedCallback";
+constexpr char kFirstShownCallbackMethod[] = "FirstShownCallback";
+constexpr char kWindowEventCallbackMethod[] = "WindowEventCallback";
+
+// Event names, see kAppWindowEvent* in Dart.
+constexpr char kShownEvent[] = "shown";
+constexpr char kHiddenEvent[] = "hidden";
+constexpr char kIconifiedEvent[] = "iconified";
+constexpr char kDeiconifiedEvent[] = "deiconified";
+constexpr char kFocusedEvent[] = "focused";
+constexpr char kUnfocusedEvent[] = "unfocused";
+
+constexpr char kShowAppWindowAction[] = "show_app_window";
+constexpr char kHideAppWindowAction[] = "hide_app_window";
+constexpr char kToggleAppWindowAction[] = "toggle_app_window";
+constexpr char kCloseAppWindowAction[] = "close_app_window";
+
+// Channel the framework listens on for system messages such as
+// `memoryPressure` (see SystemChannels.system).
+constexpr char kSystemChannelName[] = "flutter/system";
+constexpr char kSystemMessageTypeKey[] = "type";
+constexpr char kMemoryPressureType[] = "memoryPressure";
+
+constexpr guint kDefaultBackgroundDelayMs = 30 * 1000;
+
+constexpr gint kOffscreenPosition = -32000;
+
+// Only X11 lets applications place their windows, e.g. off-screen.
+bool can_move_offscreen() {
+#ifdef GDK_WINDOWING_X11
+  return GDK_IS_X11_DISPLAY(gdk_display_get_default());
+#else
+  return false;
+#endif
+}
+
+}  // namespace
 
 // static
 gboolean AppWindow::static_window_state_event_callback_fun(
@@ -19,27 +89,149 @@ gboolean AppWindow::static_window_state_event_callback_fun(
 gboolean AppWindow::window_state_event_callback_fun(
     GtkWidget* widget,
     GdkEventWindowState* event) {
-  if (event->changed_mask & GDK_WINDOW_STATE_ICONIFIED) {
-    window_iconify_ = true;
-  } else {
-    window_iconify_ = false;
+  window_iconified_ =
+      (event->new_window_state & GDK_WINDOW_STATE_ICONIFIED) != 0;
+  update_window_state();
+  // Let GTK and the runner see the event as well.
+  return FALSE;
+}
+
+// static
+void AppWindow::static_visibility_callback_fun(GtkWidget* widget,
+                                               AppWindow* self) {
+  self->update_window_state();
+}
+
+// static
+void AppWindow::static_active_callback_fun(GObject* object,
+                                           GParamSpec* pspec,
+                                           AppWindow* self) {
+  self->update_window_state();
+}
+
+AppWindow::WindowState AppWindow::get_window_state() const {
+  WindowState state;
+  state.shown = !is_app_window_hidden();
+  state.iconified = window_iconified_;
+  // An off-screen window can stay active, but doesn't take input.
+  state.focused = !offscreen_ && gtk_window_is_active(window_);
+  return state;
+}
+
+void AppWindow::update_window_state() {
+  if (!window_) {
+    return;
+  }
+
+  WindowState state = get_window_state();
+  std::vector<const char*> events;
+  if (state.shown != window_state_.shown) {
+    events.push_back(state.shown ? kShownEvent : kHiddenEvent);
+  }
+  if (state.iconified != window_state_.iconified) {
+    events.push_back(state.iconified ? kIconifiedEvent : kDeiconifiedEvent);
+  }
+  if (state.focused != window_state_.focused) {
+    events.push_back(state.focused ? kFocusedEvent : kUnfocusedEvent);
+  }
+  window_state_ = state;
+
+  for (const char* event : events) {
+    g_autoptr(FlValue) result = fl_value_new_string(event);
+    invoke_method(kWindowEventCallbackMethod, result);
+  }
+}
+
+void AppWindow::invoke_method(const gchar* method, FlValue* args) {
+  if (!channel_) {
+    return;
+  }
+  fl_method_channel_invoke_method(channel_, method, args, nullptr, nullptr,
+                                  nullptr);
+}
+
+// static
+gboolean AppWindow::static_delete_event_callback_fun(GtkWidget* widget,
+                                                     GdkEvent* event,
+                                                     AppWindow* self) {
+  if (!self->close_to_tray_ || self->closing_) {
+    self->closing_ = false;
+    return FALSE;
   }
+
+  self->hide_app_window();
+  self->invoke_method(kCloseRequestedCallbackMethod, nullptr);
   return TRUE;
 }
 
+// static
+gboolean AppWindow::static_background_timeout_callback_fun(
+    gpointer user_data) {
+  AppWindow* self = reinterpret_cast<AppWindow*>(user_data);
+  self->background_timer_id_ = 0;
+  self->enter_background_mode();
+  return G_SOURCE_REMOVE;
+}
+
+// static
+gboolean AppWindow::static_draw_callback_fun(GtkWidget* widget,
+                                             cairo_t* cr,
+                                             AppWindow* self) {
+  self->draw_callback_fun(widget, cr);
+  return FALSE;
+}
+
+void AppWindow::draw_callback_fun(GtkWidget* widget, cairo_t* cr) {
+  if (show_requested_time_ == 0) {
+    return;
+  }
+
+  show_latency_last_us_ = g_get_monotonic_time() - show_requested_time_;
+  show_latency_total_us_ += show_latency_last_us_;
+  show_latency_count_++;
+  show_requested_time_ = 0;
+
+  if (first_show_pending_) {
+    first_show_pending_ = false;
+
+    g_autoptr(FlValue) result = fl_value_new_map();
+    fl_value_set_string_take(result, kLatencyKey,
+                             fl_value_new_int(show_latency_last_us_));
+    invoke_method(kFirstShownCallbackMethod, result);
+  }
+}
+
 AppWindow::AppWindow(FlPluginRegistrar* registrar,
                      FlMethodChannel* channel) noexcept
     : registrar_(registrar), channel_(channel) {}
 
 AppWindow::~AppWindow() noexcept {
+  cancel_background_mode();
+
+  // The window usually outlives the plugin.
+  if (window_) {
+    g_signal_handlers_disconnect_by_data(window_, this);
+    g_object_remove_weak_pointer(G_OBJECT(window_),
+                                 reinterpret_cast<gpointer*>(&window_));
+    window_ = nullptr;
+  }
+
   channel_ = nullptr;
 }
 
 void AppWindow::handle_method_call(FlMethodCall* method_call) {
-  g_autoptr(FlMethodResponse) response = nullptr;
+  g_autoptr(FlMethodResponse) response =
+      handle_method(fl_method_call_get_name(method_call),
+                    fl_method_call_get_args(method_call));
 
-  const gchar* method = fl_method_call_get_name(method_call);
-  FlValue* args = fl_method_call_get_args(method_call);
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+FlMethodResponse* AppWindow::handle_method(const gchar* method, FlValue* args) {
+  FlMethodResponse* response = nullptr;
 
   // g_print("method call %s\n", method);
 
@@ -51,14 +243,37 @@ void AppWindow::handle_method_call(FlMethodCall* method_call) {
     response = hide_app_window(args);
   } else if (strcmp(method, kCloseAppWindow) == 0) {
     response = close_app_window(args);
+  } else if (strcmp(method, kSetBackgroundMode) == 0) {
+    response = set_background_mode(args);
+  } else if (strcmp(method, kGetBackgroundStats) == 0) {
+    response = get_background_stats(args);
+  } else if (strcmp(method, kSetRestoreMode) == 0) {
+    response = set_restore_mode(args);
+  } else if (strcmp(method, kGetShowLatency) == 0) {
+    response = get_show_latency(args);
+  } else if (strcmp(method, kSetCloseToTray) == 0) {
+    response = set_close_to_tray(args);
   } else {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
 
-  g_autoptr(GError) error = nullptr;
-  if (!fl_method_call_respond(method_call, response, &error)) {
-    g_warning("Failed to send method call response: %s", error->message);
+  return response;
+}
+
+void AppWindow::notify_activated(const std::vector<std::string>& arguments) {
+  if (!window_) {
+    pending_activations_.push_back(arguments);
+    return;
   }
+
+  g_autoptr(FlValue) argument_list = fl_value_new_list();
+  for (const auto& argument : arguments) {
+    fl_value_append_take(argument_list, fl_value_new_string(argument.c_str()));
+  }
+
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string(result, kArgumentsKey, argument_list);
+  invoke_method(kActivatedCallbackMethod, result);
 }
 
 FlMethodResponse* AppWindow::init_app_window(FlValue* args) {
@@ -80,12 +295,27 @@ FlMethodResponse* AppWindow::init_app_window(FlValue* args) {
       break;
     }
 
+    if (args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+      FlValue* close_to_tray_value =
+          fl_value_lookup_string(args, kCloseToTrayKey);
+      if (close_to_tray_value &&
+          fl_value_get_type(close_to_tray_value) == FL_VALUE_TYPE_BOOL) {
+        close_to_tray_ = fl_value_get_bool(close_to_tray_value);
+      }
+    }
+
     if (!init_app_window(window)) {
       response = FL_METHOD_RESPONSE(fl_method_error_response_new(
           errors::kBadArgumentsError, "", fl_value_new_bool(FALSE)));
       break;
     }
 
+    std::vector<std::vector<std::string>> pending_activations;
+    pending_activations.swap(pending_activations_);
+    for (const auto& arguments : pending_activations) {
+      notify_activated(arguments);
+    }
+
     result = fl_value_new_bool(TRUE);
 
   } while (false);
@@ -153,19 +383,284 @@ FlMethodResponse* AppWindow::close_app_window(FlValue* args) {
   return response;
 }
 
+FlMethodResponse* AppWindow::set_background_mode(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  FlMethodResponse* response = nullptr;
+
+  do {
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    FlValue* enabled_value = fl_value_lookup_string(args, kEnabledKey);
+    if (!enabled_value ||
+        fl_value_get_type(enabled_value) != FL_VALUE_TYPE_BOOL) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    guint delay_ms = kDefaultBackgroundDelayMs;
+    FlValue* delay_value = fl_value_lookup_string(args, kDelayKey);
+    if (delay_value && fl_value_get_type(delay_value) == FL_VALUE_TYPE_INT &&
+        fl_value_get_int(delay_value) >= 0) {
+      delay_ms = static_cast<guint>(fl_value_get_int(delay_value));
+    }
+
+    background_mode_enabled_ = fl_value_get_bool(enabled_value);
+    background_delay_ms_ = delay_ms;
+
+    cancel_background_mode();
+    if (background_mode_enabled_ && is_app_window_hidden()) {
+      schedule_background_mode();
+    }
+
+    result = fl_value_new_bool(TRUE);
+
+  } while (false);
+
+  if (nullptr == response) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  return response;
+}
+
+FlMethodResponse* AppWindow::get_background_stats(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_map();
+
+  fl_value_set_string_take(result, kEnabledKey,
+                           fl_value_new_bool(background_mode_enabled_));
+  fl_value_set_string_take(result, kActiveKey,
+                           fl_value_new_bool(background_mode_active_));
+  fl_value_set_string_take(result, kRssBeforeKey,
+                           fl_value_new_int(background_rss_before_));
+  fl_value_set_string_take(result, kRssAfterKey,
+                           fl_value_new_int(background_rss_after_));
+  fl_value_set_string_take(result, kTrimCountKey,
+                           fl_value_new_int(background_trim_count_));
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* AppWindow::set_restore_mode(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  FlMethodResponse* response = nullptr;
+
+  do {
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    FlValue* mode_value = fl_value_lookup_string(args, kRestoreModeKey);
+    if (!mode_value || fl_value_get_type(mode_value) != FL_VALUE_TYPE_STRING) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    const gchar* mode = fl_value_get_string(mode_value);
+    if (strcmp(mode, kRestoreModeHide) == 0) {
+      restore_mode_ = RestoreMode::kHide;
+    } else if (strcmp(mode, kRestoreModeOffscreen) == 0) {
+      restore_mode_ = RestoreMode::kOffscreen;
+    } else {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    result = fl_value_new_bool(TRUE);
+
+  } while (false);
+
+  if (nullptr == response) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  return response;
+}
+
+FlMethodResponse* AppWindow::get_show_latency(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_map();
+
+  fl_value_set_string_take(
+      result, kRestoreModeKey,
+      fl_value_new_string(restore_mode_ == RestoreMode::kOffscreen
+                              ? kRestoreModeOffscreen
+                              : kRestoreModeHide));
+  fl_value_set_string_take(result, kLastKey,
+                           fl_value_new_int(show_latency_last_us_));
+  fl_value_set_string_take(
+      result, kAverageKey,
+      fl_value_new_int(show_latency_count_
+                           ? show_latency_total_us_ / show_latency_count_
+                           : 0));
+  fl_value_set_string_take(result, kCountKey,
+                           fl_value_new_int(show_latency_count_));
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* AppWindow::set_close_to_tray(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  FlMethodResponse* response = nullptr;
+
+  do {
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    FlValue* enabled_value = fl_value_lookup_string(args, kEnabledKey);
+    if (!enabled_value ||
+        fl_value_get_type(enabled_value) != FL_VALUE_TYPE_BOOL) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    close_to_tray_ = fl_value_get_bool(enabled_value);
+
+    result = fl_value_new_bool(TRUE);
+
+  } while (false);
+
+  if (nullptr == response) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  return response;
+}
+
+bool AppWindow::run_native_action(const gchar* action) {
+  if (strcmp(action, kShowAppWindowAction) == 0) {
+    show_app_window();
+  } else if (strcmp(action, kHideAppWindowAction) == 0) {
+    hide_app_window();
+  } else if (strcmp(action, kToggleAppWindowAction) == 0) {
+    if (is_app_window_hidden()) {
+      show_app_window();
+    } else {
+      hide_app_window();
+    }
+  } else if (strcmp(action, kCloseAppWindowAction) == 0) {
+    close_app_window();
+  } else {
+    return false;
+  }
+  return true;
+}
+
 bool AppWindow::init_app_window(GtkWindow* window) {
+  // Called again after a hot restart.
+  if (window_) {
+    g_signal_handlers_disconnect_by_data(window_, this);
+    g_object_remove_weak_pointer(G_OBJECT(window_),
+                                 reinterpret_cast<gpointer*>(&window_));
+  } else {
+    first_show_pending_ = !gtk_widget_get_visible(GTK_WIDGET(window));
+  }
+
   window_ = window;
+  // Cleared if the window is destroyed first.
+  g_object_add_weak_pointer(G_OBJECT(window_),
+                            reinterpret_cast<gpointer*>(&window_));
+  window_state_ = get_window_state();
   g_signal_connect(
       G_OBJECT(window_), "window-state-event",
       G_CALLBACK(AppWindow::static_window_state_event_callback_fun), this);
+  g_signal_connect(G_OBJECT(window_), "map",
+                   G_CALLBACK(AppWindow::static_visibility_callback_fun), this);
+  g_signal_connect(G_OBJECT(window_), "unmap",
+                   G_CALLBACK(AppWindow::static_visibility_callback_fun), this);
+  g_signal_connect(G_OBJECT(window_), "notify::is-active",
+                   G_CALLBACK(AppWindow::static_active_callback_fun), this);
+  g_signal_connect(G_OBJECT(window_), "delete-event",
+                   G_CALLBACK(AppWindow::static_delete_event_callback_fun),
+                   this);
+  g_signal_connect_after(G_OBJECT(window_), "draw",
+                         G_CALLBACK(AppWindow::static_draw_callback_fun),
+                         this);
+  g_signal_connect(
+      G_OBJECT(window_), "configure-event",
+      G_CALLBACK(AppWindow::static_configure_event_callback_fun), this);
+  g_signal_connect(G_OBJECT(window_), "key-press-event",
+                   G_CALLBACK(AppWindow::static_key_event_callback_fun), this);
+  g_signal_connect(G_OBJECT(window_), "key-release-event",
+                   G_CALLBACK(AppWindow::static_key_event_callback_fun), this);
   return true;
 }
 
+// static
+gboolean AppWindow::static_configure_event_callback_fun(
+    GtkWidget* widget,
+    GdkEventConfigure* event,
+    AppWindow* self) {
+  // Window managers like mutter keep windows on screen, so the move didn't
+  // take and the window has to be unmapped after all.
+  if (self->offscreen_ && self->is_on_screen()) {
+    self->hide_offscreen_window();
+  }
+  return FALSE;
+}
+
+// static
+gboolean AppWindow::static_key_event_callback_fun(GtkWidget* widget,
+                                                  GdkEventKey* event,
+                                                  AppWindow* self) {
+  // An off-screen window may still have the keyboard focus; its keys are
+  // dropped rather than handled by a window the user can't see.
+  return self->offscreen_;
+}
+
+bool AppWindow::is_on_screen() const {
+  GdkWindow* gdk_window = gtk_widget_get_window(GTK_WIDGET(window_));
+  if (!gdk_window) {
+    return false;
+  }
+
+  GdkRectangle frame;
+  gdk_window_get_frame_extents(gdk_window, &frame);
+
+  GdkDisplay* display = gdk_window_get_display(gdk_window);
+  for (int i = 0; i < gdk_display_get_n_monitors(display); ++i) {
+    GdkRectangle geometry;
+    gdk_monitor_get_geometry(gdk_display_get_monitor(display, i), &geometry);
+    if (gdk_rectangle_intersect(&frame, &geometry, nullptr)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void AppWindow::hide_offscreen_window() {
+  gtk_widget_hide(GTK_WIDGET(window_));
+  gtk_window_set_skip_taskbar_hint(window_, FALSE);
+  gtk_window_set_skip_pager_hint(window_, FALSE);
+  gtk_window_set_accept_focus(window_, TRUE);
+  offscreen_ = false;
+  update_window_state();
+}
+
 bool AppWindow::show_app_window() {
   if (!window_) {
     return false;
   }
 
+  show_requested_time_ = g_get_monotonic_time();
+
+  cancel_background_mode();
+
+  if (offscreen_) {
+    gtk_window_set_skip_taskbar_hint(window_, FALSE);
+    gtk_window_set_skip_pager_hint(window_, FALSE);
+    gtk_window_set_accept_focus(window_, TRUE);
+    offscreen_ = false;
+  }
+
   if (x_ != -1 && y_ != -1) {
     gtk_window_move(window_, x_, y_);
     x_ = -1;
@@ -175,10 +670,16 @@ bool AppWindow::show_app_window() {
   gtk_widget_show(GTK_WIDGET(window_));
   gtk_window_present(window_);
 
-  if (window_iconify_) {
+  if (window_iconified_) {
     gtk_window_deiconify(window_);
   }
 
+  update_window_state();
+
+  // Make sure a frame is produced even if nothing changed while hidden, so the
+  // latency sample is taken.
+  gtk_widget_queue_draw(GTK_WIDGET(window_));
+
   // GdkWindow* gdk_window = gtk_widget_get_window(GTK_WIDGET(window_));
   // GdkDisplay* display = gdk_window_get_display(gdk_window);
   // gdk_display_flush(display);
@@ -190,8 +691,30 @@ bool AppWindow::hide_app_window() {
     return false;
   }
 
+  if (is_app_window_hidden()) {
+    return true;
+  }
+
+  show_requested_time_ = 0;
+
   gtk_window_get_position(window_, &x_, &y_);
-  gtk_widget_hide(GTK_WIDGET(window_));
+  if (restore_mode_ == RestoreMode::kOffscreen && can_move_offscreen()) {
+    // The window manager doesn't give it the focus again while it is
+    // off-screen.
+    gtk_window_set_accept_focus(window_, FALSE);
+    gtk_window_set_skip_taskbar_hint(window_, TRUE);
+    gtk_window_set_skip_pager_hint(window_, TRUE);
+    gtk_window_move(window_, kOffscreenPosition, kOffscreenPosition);
+    offscreen_ = true;
+  } else {
+    gtk_widget_hide(GTK_WIDGET(window_));
+  }
+
+  update_window_state();
+
+  if (background_mode_enabled_) {
+    schedule_background_mode();
+  }
   return true;
 }
 
@@ -200,6 +723,78 @@ bool AppWindow::close_app_window() {
     return false;
   }
 
+  // An explicit close quits even in close-to-tray mode. The delete event is
+  // sent from an idle callback.
+  closing_ = true;
   gtk_window_close(window_);
   return true;
-}
\ No newline at end of file
+}
+
+bool AppWindow::is_app_window_hidden() const {
+  return window_ &&
+         (offscreen_ || !gtk_widget_get_visible(GTK_WIDGET(window_)));
+}
+
+void AppWindow::schedule_background_mode() {
+  if (background_timer_id_ != 0 || background_mode_active_) {
+    return;
+  }
+
+  background_timer_id_ = g_timeout_add(
+      background_delay_ms_, AppWindow::static_background_timeout_callback_fun,
+      this);
+}
+
+void AppWindow::cancel_background_mode() {
+  if (background_timer_id_ != 0) {
+    g_source_remove(background_timer_id_);
+    background_timer_id_ = 0;
+  }
+
+  leave_background_mode();
+}
+
+void AppWindow::enter_background_mode() {
+  if (background_mode_active_) {
+    return;
+  }
+
+  background_rss_before_ = utils::get_resident_set_size();
+
+  send_memory_pressure();
+
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+
+  background_rss_after_ = utils::get_resident_set_size();
+  background_trim_count_++;
+  background_mode_active_ = true;
+}
+
+void AppWindow::leave_background_mode() {
+  // Everything released on entry is rebuilt lazily: the framework repopulates
+  // its caches on the next frame.
+  background_mode_active_ = false;
+}
+
+void AppWindow::send_memory_pressure() {
+  // There is no engine to notify when replaying a trace.
+  if (!registrar_) {
+    return;
+  }
+
+  FlBinaryMessenger* messenger = fl_plugin_registrar_get_messenger(registrar_);
+  if (!messenger) {
+    return;
+  }
+
+  g_autoptr(FlJsonMessageCodec) codec = fl_json_message_codec_new();
+  g_autoptr(FlBasicMessageChannel) channel = fl_basic_message_channel_new(
+      messenger, kSystemChannelName, FL_MESSAGE_CODEC(codec));
+
+  g_autoptr(FlValue) message = fl_value_new_map();
+  fl_value_set_string_take(message, kSystemMessageTypeKey,
+                           fl_value_new_string(kMemoryPressureType));
+  fl_basic_message_channel_send(channel, message, nullptr, nullptr, nullptr);
+}
@@ -3,29 +3,69 @@
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
+#include <memory>
+#include <string>
+#include <vector>
 
 extern const char kInitAppWindow[];
 extern const char kShowAppWindow[];
 extern const char kHideAppWindow[];
 extern const char kCloseAppWindow[];
+extern const char kSetBackgroundMode[];
+extern const char kGetBackgroundStats[];
+extern const char kSetRestoreMode[];
+extern const char kGetShowLatency[];
+extern const char kSetCloseToTray[];
 
 class AppWindow {
  public:
-  AppWindow(FlPluginRegistrar* registrar, FlMethodChannel* channel) noexcept;
+  AppWindow(FlPluginRegistrar* registrar,
+            FlMethodChannel* channel) noexcept;
   ~AppWindow() noexcept;
 
   void handle_method_call(FlMethodCall* method_call);
 
+  // Runs |method| with |args| and returns the response for Dart, e.g. for
+  // replaying recorded calls without a method channel.
+  FlMethodResponse* handle_method(const gchar* method, FlValue* args);
+
+  // Notifies Dart that another launch of the application was forwarded here.
+  // Launches arriving before Dart initialized the window are queued.
+  void notify_activated(const std::vector<std::string>& arguments);
+
+  // Runs a menu item's native action, e.g. "toggle_app_window", without
+  // waiting for Dart. Returns false for unknown actions.
+  bool run_native_action(const gchar* action);
+
  protected:
   FlMethodResponse* init_app_window(FlValue* args);
   FlMethodResponse* show_app_window(FlValue* args);
   FlMethodResponse* hide_app_window(FlValue* args);
   FlMethodResponse* close_app_window(FlValue* args);
+  FlMethodResponse* set_background_mode(FlValue* args);
+  FlMethodResponse* get_background_stats(FlValue* args);
+  FlMethodResponse* set_restore_mode(FlValue* args);
+  FlMethodResponse* get_show_latency(FlValue* args);
+  FlMethodResponse* set_close_to_tray(FlValue* args);
 
   bool init_app_window(GtkWindow* window);
   bool show_app_window();
   bool hide_app_window();
   bool close_app_window();
+  bool is_app_window_hidden() const;
+
+  void schedule_background_mode();
+  void cancel_background_mode();
+  void enter_background_mode();
+  void leave_background_mode();
+  void send_memory_pressure();
+
+  static gboolean static_background_timeout_callback_fun(gpointer user_data);
+
+  static gboolean static_draw_callback_fun(GtkWidget* widget,
+                                          cairo_t* cr,
+                                          AppWindow* self);
+  void draw_callback_fun(GtkWidget* widget, cairo_t* cr);
 
   static gboolean static_window_state_event_callback_fun(
       GtkWidget* widget,
@@ -35,14 +75,94 @@ class AppWindow {
   gboolean window_state_event_callback_fun(GtkWidget* widget,
                                            GdkEventWindowState* event);
 
+  static void static_visibility_callback_fun(GtkWidget* widget,
+                                             AppWindow* self);
+  static void static_active_callback_fun(GObject* object,
+                                         GParamSpec* pspec,
+                                         AppWindow* self);
+
+  // Tells Dart about the transitions of the window since the last call.
+  void update_window_state();
+
+  // Calls |method| in Dart. Does nothing without a channel, e.g. when
+  // replaying a trace.
+  void invoke_method(const gchar* method, FlValue* args);
+
+  static gboolean static_delete_event_callback_fun(GtkWidget* widget,
+                                                   GdkEvent* event,
+                                                   AppWindow* self);
+
+  static gboolean static_configure_event_callback_fun(
+      GtkWidget* widget,
+      GdkEventConfigure* event,
+      AppWindow* self);
+  static gboolean static_key_event_callback_fun(GtkWidget* widget,
+                                                GdkEventKey* event,
+                                                AppWindow* self);
+
+  // Whether any part of the window is on a monitor.
+  bool is_on_screen() const;
+  // Unmaps a window that was moved off-screen, see RestoreMode::kOffscreen.
+  void hide_offscreen_window();
+
  protected:
+  struct WindowState {
+    bool shown = false;
+    bool iconified = false;
+    bool focused = false;
+  };
+
+  WindowState get_window_state() const;
+
+  enum class RestoreMode {
+    // Unmaps the window on hide.
+    kHide,
+    // Keeps the window mapped and moves it off-screen on hide, so that showing
+    // it again doesn't need a new map and first paint. X11 only; elsewhere,
+    // and when the window manager keeps the window on screen, it is unmapped
+    // as with kHide.
+    kOffscreen,
+  };
+
   FlPluginRegistrar* registrar_ = nullptr;
   FlMethodChannel* channel_ = nullptr;
 
   GtkWindow* window_ = nullptr;
-  bool window_iconify_ = false;
+  bool window_iconified_ = false;
+  // As last reported to Dart.
+  WindowState window_state_;
   gint x_ = -1;
   gint y_ = -1;
+
+  std::vector<std::vector<std::string>> pending_activations_;
+
+  // Hides the window when the user closes it, keeping the engine running so
+  // it can be shown again without a cold start. close_app_window() still
+  // closes it.
+  bool close_to_tray_ = false;
+  bool closing_ = false;
+
+  // Set if the window wasn't shown yet when Dart initialized it, see
+  // system_tray_plugin_start_hidden(). Dart is told once the first show has
+  // been drawn.
+  bool first_show_pending_ = false;
+
+  bool background_mode_enabled_ = false;
+  bool background_mode_active_ = false;
+  guint background_delay_ms_ = 0;
+  guint background_timer_id_ = 0;
+  int64_t background_rss_before_ = 0;
+  int64_t background_rss_after_ = 0;
+  int64_t background_trim_count_ = 0;
+
+  RestoreMode restore_mode_ = RestoreMode::kHide;
+  bool offscreen_ = false;
+
+  // Time from ShowAppWindow to the first frame drawn afterwards.
+  gint64 show_requested_time_ = 0;
+  gint64 show_latency_last_us_ = 0;
+  gint64 show_latency_total_us_ = 0;
+  gint64 show_latency_count_ = 0;
 };
 
 #endif  // __APPWINDOW_H__
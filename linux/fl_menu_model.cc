@@ -0,0 +1,146 @@
+#include "fl_menu_model.h"
+
+#include <string.h>
+
+namespace {
+
+constexpr char kIdKey[] = "id";
+constexpr char kTypeKey[] = "type";
+constexpr char kLabelKey[] = "label";
+constexpr char kImageKey[] = "image";
+constexpr char kEnabledKey[] = "enabled";
+constexpr char kCheckedKey[] = "checked";
+constexpr char kSubMenuKey[] = "submenu";
+constexpr char kNativeActionKey[] = "native_action";
+
+constexpr const char* kTypeNames[] = {"label", "checkbox", "submenu",
+                                      "separator", "radio"};
+
+const gchar* lookup_string(FlValue* map, const char* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  return value && fl_value_get_type(value) == FL_VALUE_TYPE_STRING
+             ? fl_value_get_string(value)
+             : nullptr;
+}
+
+bool lookup_type(FlValue* map, MenuItemType* type) {
+  const gchar* name = lookup_string(map, kTypeKey);
+  if (!name) {
+    return false;
+  }
+
+  // Anything else is shown as a plain label, as it always was.
+  *type = MenuItemType::kLabel;
+  for (size_t i = 0; i < G_N_ELEMENTS(kTypeNames); ++i) {
+    if (strcmp(name, kTypeNames[i]) == 0) {
+      *type = static_cast<MenuItemType>(i);
+    }
+  }
+  return true;
+}
+
+bool parse_list(FlValue* list, MenuModel* model) {
+  if (fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    return false;
+  }
+
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* value = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
+      return false;
+    }
+
+    MenuItemFields fields;
+    if (!lookup_type(value, &fields.type)) {
+      return false;
+    }
+
+    FlValue* id_value = fl_value_lookup_string(value, kIdKey);
+    if (id_value && fl_value_get_type(id_value) == FL_VALUE_TYPE_INT) {
+      fields.id = fl_value_get_int(id_value);
+    }
+
+    fields.label = lookup_string(value, kLabelKey);
+    fields.image = lookup_string(value, kImageKey);
+    fields.native_action = lookup_string(value, kNativeActionKey);
+
+    FlValue* enabled_value = fl_value_lookup_string(value, kEnabledKey);
+    if (enabled_value &&
+        fl_value_get_type(enabled_value) == FL_VALUE_TYPE_BOOL) {
+      fields.enabled = fl_value_get_bool(enabled_value);
+    }
+
+    FlValue* checked_value = fl_value_lookup_string(value, kCheckedKey);
+    if (checked_value &&
+        fl_value_get_type(checked_value) == FL_VALUE_TYPE_BOOL) {
+      fields.checked = fl_value_get_bool(checked_value);
+    }
+
+    uint32_t index = model->append_item(fields);
+
+    if (fields.type == MenuItemType::kSubMenu) {
+      FlValue* children = fl_value_lookup_string(value, kSubMenuKey);
+      if (!children || !parse_list(children, model)) {
+        return false;
+      }
+      model->end_submenu(index);
+    }
+  }
+  return true;
+}
+
+FlValue* list_to_value(const MenuModel& model, uint32_t begin, uint32_t end) {
+  FlValue* list = fl_value_new_list();
+  for (uint32_t i = begin; i < end; i = model.end(i)) {
+    MenuItemType type = model.type(i);
+
+    FlValue* value = fl_value_new_map();
+    fl_value_set_string_take(
+        value, kTypeKey,
+        fl_value_new_string(kTypeNames[static_cast<size_t>(type)]));
+    if (type != MenuItemType::kSeparator) {
+      fl_value_set_string_take(value, kIdKey, fl_value_new_int(model.id(i)));
+      fl_value_set_string_take(value, kLabelKey,
+                               fl_value_new_string(model.label(i)));
+      if (*model.image(i)) {
+        fl_value_set_string_take(value, kImageKey,
+                                 fl_value_new_string(model.image(i)));
+      }
+      fl_value_set_string_take(value, kEnabledKey,
+                               fl_value_new_bool(model.enabled(i)));
+    }
+    if (type == MenuItemType::kCheckbox || type == MenuItemType::kRadio) {
+      fl_value_set_string_take(value, kCheckedKey,
+                               fl_value_new_bool(model.checked(i)));
+    } else if (type == MenuItemType::kSubMenu) {
+      fl_value_set_string_take(value, kSubMenuKey,
+                               list_to_value(model, i + 1, model.end(i)));
+    }
+    if (*model.native_action(i)) {
+      fl_value_set_string_take(value, kNativeActionKey,
+                               fl_value_new_string(model.native_action(i)));
+    }
+    fl_value_append_take(list, value);
+  }
+  return list;
+}
+
+}  // namespace
+
+bool fl_menu_model_parse(FlValue* menu_list, MenuModel* model) {
+  model->clear();
+  if (fl_value_get_type(menu_list) == FL_VALUE_TYPE_LIST) {
+    model->reserve(fl_value_get_length(menu_list), 0);
+  }
+
+  if (!parse_list(menu_list, model)) {
+    model->clear();
+    return false;
+  }
+  model->check_radio_groups();
+  return true;
+}
+
+FlValue* fl_menu_model_to_value(const MenuModel& model) {
+  return list_to_value(model, 0, model.size());
+}
@@ -0,0 +1,15 @@
+#ifndef __FL_MENU_MODEL_H__
+#define __FL_MENU_MODEL_H__
+
+#include <flutter_linux/flutter_linux.h>
+
+#include "../common/menu_model.h"
+
+// Parses the menu_list of a CreateContextMenu call into |model|. Returns false
+// if it is malformed, leaving |model| cleared.
+bool fl_menu_model_parse(FlValue* menu_list, MenuModel* model);
+
+// Returns the menu_list representation of |model|, as Dart sends it.
+FlValue* fl_menu_model_to_value(const MenuModel& model);
+
+#endif  // __FL_MENU_MODEL_H__
@@ -0,0 +1,95 @@
+#include "headless_indicator.h"
+
+#include "indicator_api.h"
+#include "utils.h"
+
+constexpr char kHeadlessIndicatorEnvironmentVariable[] =
+    "SYSTEM_TRAY_HEADLESS_INDICATOR";
+
+namespace {
+
+constexpr char kLabelKey[] = "headless-indicator-label";
+constexpr char kMenuKey[] = "headless-indicator-menu";
+constexpr char kActiveKey[] = "headless-indicator-active";
+constexpr char kIconKey[] = "headless-indicator-icon";
+
+int64_t g_visible_uptime_us = 0;
+
+void update_visible(AppIndicator* self) {
+  if (g_visible_uptime_us != 0) {
+    return;
+  }
+
+  if (g_object_get_data(G_OBJECT(self), kActiveKey) &&
+      g_object_get_data(G_OBJECT(self), kIconKey)) {
+    g_visible_uptime_us = utils::get_process_uptime_us();
+  }
+}
+
+AppIndicator* headless_app_indicator_new(const gchar* id,
+                                         const gchar* icon_name,
+                                         AppIndicatorCategory category) {
+  return reinterpret_cast<AppIndicator*>(g_object_new(G_TYPE_OBJECT, nullptr));
+}
+
+void headless_app_indicator_set_status(AppIndicator* self,
+                                       AppIndicatorStatus status) {
+  g_object_set_data(G_OBJECT(self), kActiveKey,
+                    GINT_TO_POINTER(status != APP_INDICATOR_STATUS_PASSIVE));
+  update_visible(self);
+}
+
+void headless_app_indicator_set_icon_full(AppIndicator* self,
+                                          const gchar* icon_name,
+                                          const gchar* icon_desc) {
+  g_object_set_data_full(G_OBJECT(self), kIconKey, g_strdup(icon_name),
+                         g_free);
+  update_visible(self);
+}
+
+void headless_app_indicator_set_attention_icon_full(AppIndicator* self,
+                                                    const gchar* icon_name,
+                                                    const gchar* icon_desc) {}
+
+void headless_app_indicator_set_label(AppIndicator* self,
+                                      const gchar* label,
+                                      const gchar* guide) {
+  g_object_set_data_full(G_OBJECT(self), kLabelKey, g_strdup(label), g_free);
+}
+
+void headless_app_indicator_set_title(AppIndicator* self, const gchar* title) {}
+
+const gchar* headless_app_indicator_get_label(AppIndicator* self) {
+  return static_cast<const gchar*>(
+      g_object_get_data(G_OBJECT(self), kLabelKey));
+}
+
+void headless_app_indicator_set_menu(AppIndicator* self, GtkMenu* menu) {
+  g_object_set_data_full(G_OBJECT(self), kMenuKey, g_object_ref_sink(menu),
+                         g_object_unref);
+}
+
+}  // namespace
+
+bool headless_indicator_requested() {
+  const gchar* value = g_getenv(kHeadlessIndicatorEnvironmentVariable);
+  return value && *value && g_strcmp0(value, "0") != 0;
+}
+
+void headless_indicator_install() {
+  IndicatorApi api;
+  api.app_indicator_new = headless_app_indicator_new;
+  api.app_indicator_set_status = headless_app_indicator_set_status;
+  api.app_indicator_set_icon_full = headless_app_indicator_set_icon_full;
+  api.app_indicator_set_attention_icon_full =
+      headless_app_indicator_set_attention_icon_full;
+  api.app_indicator_set_label = headless_app_indicator_set_label;
+  api.app_indicator_set_title = headless_app_indicator_set_title;
+  api.app_indicator_get_label = headless_app_indicator_get_label;
+  api.app_indicator_set_menu = headless_app_indicator_set_menu;
+  indicator_api_set_for_testing(api);
+}
+
+int64_t headless_indicator_visible_uptime_us() {
+  return g_visible_uptime_us;
+}
@@ -0,0 +1,21 @@
+#ifndef __HEADLESS_INDICATOR_H__
+#define __HEADLESS_INDICATOR_H__
+
+#include <stdint.h>
+
+// Set to use the headless indicator instead of the appindicator library,
+// e.g. to run the example's integration tests under Xvfb.
+extern const char kHeadlessIndicatorEnvironmentVariable[];
+
+bool headless_indicator_requested();
+
+// Replaces the appindicator entry points with a stand-in that keeps a
+// reference to its menu the same way the real one does, without needing a
+// status notifier host. Must be called before the first Tray is initialized.
+void headless_indicator_install();
+
+// Returns the process uptime in microseconds at which an indicator was first
+// active with an icon, or 0 if none was yet.
+int64_t headless_indicator_visible_uptime_us();
+
+#endif  // __HEADLESS_INDICATOR_H__
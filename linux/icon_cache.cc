@@ -0,0 +1,256 @@
+#include "icon_cache.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Resolution variants Flutter bundles next to an asset.
+constexpr const char* kVariantDirs[] = {"1.5x", "2.0x", "3.0x", "4.0x"};
+
+// Rasterized icons kept in the cache directory; the least recently used ones
+// are deleted beyond that.
+constexpr size_t kMaxCachedIcons = 256;
+
+struct Lookup {
+  // Modification time and size of a file source when it was hashed, so a
+  // file rewritten at the same path is rasterized again. Empty for resources.
+  std::string stamp;
+  std::string path;
+};
+
+// Rasterized paths by source and size, to skip hashing sources again.
+std::map<std::pair<std::string, int>, Lookup> g_lookups;
+
+std::string source_stamp(const char* source) {
+  if (icon_cache_resource_path(source)) {
+    return std::string();
+  }
+
+  struct stat info;
+  if (stat(source, &info) != 0) {
+    return std::string();
+  }
+  g_autofree gchar* stamp = g_strdup_printf(
+      "%lld.%09ld-%lld", static_cast<long long>(info.st_mtim.tv_sec),
+      static_cast<long>(info.st_mtim.tv_nsec),
+      static_cast<long long>(info.st_size));
+  return stamp;
+}
+
+std::string cache_dir() {
+  g_autofree gchar* dir = g_build_filename(g_get_user_cache_dir(),
+                                           "system_tray", "icons", nullptr);
+  g_mkdir_with_parents(dir, 0700);
+  return dir;
+}
+
+// Picks the smallest candidate at least |size| pixels wide, or the largest one
+// if none is.
+std::string select_source(const char* source, int size) {
+  g_autofree gchar* dir = g_path_get_dirname(source);
+  g_autofree gchar* name = g_path_get_basename(source);
+
+  std::string selected;
+  int selected_width = 0;
+
+  auto consider = [&](const gchar* candidate) {
+    int width = 0;
+    if (!gdk_pixbuf_get_file_info(candidate, &width, nullptr)) {
+      return;
+    }
+
+    bool fits = width >= size;
+    bool selected_fits = selected_width >= size;
+    bool better = fits ? (!selected_fits || width < selected_width)
+                       : (!selected_fits && width > selected_width);
+    if (selected.empty() || better) {
+      selected = candidate;
+      selected_width = width;
+    }
+  };
+
+  consider(source);
+  for (const char* variant : kVariantDirs) {
+    g_autofree gchar* candidate =
+        g_build_filename(dir, variant, name, nullptr);
+    if (g_file_test(candidate, G_FILE_TEST_IS_REGULAR)) {
+      consider(candidate);
+    }
+  }
+
+  return selected;
+}
+
+GBytes* read_source(const char* source) {
+  const char* resource_path = icon_cache_resource_path(source);
+  if (resource_path) {
+    // Points into the mapped bundle, nothing is copied.
+    return g_resources_lookup_data(resource_path, G_RESOURCE_LOOKUP_FLAGS_NONE,
+                                   nullptr);
+  }
+
+  gchar* contents = nullptr;
+  gsize length = 0;
+  if (!g_file_get_contents(source, &contents, &length, nullptr)) {
+    return nullptr;
+  }
+  return g_bytes_new_take(contents, length);
+}
+
+// Deletes the least recently used icons beyond kMaxCachedIcons.
+void prune_cache() {
+  std::string dir_path = cache_dir();
+  g_autoptr(GDir) dir = g_dir_open(dir_path.c_str(), 0, nullptr);
+  if (!dir) {
+    return;
+  }
+
+  std::vector<std::pair<gint64, std::string>> icons;
+  for (const gchar* name = g_dir_read_name(dir); name;
+       name = g_dir_read_name(dir)) {
+    if (!g_str_has_suffix(name, ".png")) {
+      continue;
+    }
+
+    g_autofree gchar* path =
+        g_build_filename(dir_path.c_str(), name, nullptr);
+    GStatBuf info;
+    if (g_stat(path, &info) == 0) {
+      icons.emplace_back(static_cast<gint64>(info.st_mtime), path);
+    }
+  }
+
+  if (icons.size() <= kMaxCachedIcons) {
+    return;
+  }
+
+  std::sort(icons.begin(), icons.end());
+  for (size_t i = 0; i < icons.size() - kMaxCachedIcons; ++i) {
+    g_unlink(icons[i].second.c_str());
+  }
+}
+
+std::string rasterize(const std::string& source, int size) {
+  g_autoptr(GBytes) contents = read_source(source.c_str());
+  if (!contents) {
+    return std::string();
+  }
+
+  gsize length = 0;
+  const void* data = g_bytes_get_data(contents, &length);
+  g_autofree gchar* hash = g_compute_checksum_for_data(
+      G_CHECKSUM_SHA256, static_cast<const guchar*>(data), length);
+  g_autofree gchar* name = g_strdup_printf("%s-%d.png", hash, size);
+  g_autofree gchar* path = g_build_filename(cache_dir().c_str(), name, nullptr);
+
+  if (g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+    // Marks it as recently used for prune_cache().
+    g_utime(path, nullptr);
+    return path;
+  }
+
+  g_autoptr(GError) error = nullptr;
+  const char* resource_path = icon_cache_resource_path(source.c_str());
+  g_autoptr(GdkPixbuf) pixbuf =
+      resource_path ? gdk_pixbuf_new_from_resource_at_scale(
+                          resource_path, size, size, TRUE, &error)
+                    : gdk_pixbuf_new_from_file_at_scale(source.c_str(), size,
+                                                        size, TRUE, &error);
+  if (!pixbuf) {
+    g_warning("Failed to rasterize %s: %s", source.c_str(), error->message);
+    return std::string();
+  }
+
+  g_autofree gchar* buffer = nullptr;
+  gsize buffer_size = 0;
+  if (!gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &buffer_size, "png", &error,
+                                 nullptr) ||
+      !g_file_set_contents(path, buffer, buffer_size, &error)) {
+    g_warning("Failed to cache %s: %s", source.c_str(), error->message);
+    return std::string();
+  }
+
+  prune_cache();
+  return path;
+}
+
+}  // namespace
+
+const char* icon_cache_resource_path(const char* source) {
+  if (!source || !g_str_has_prefix(source, kResourceScheme)) {
+    return nullptr;
+  }
+  return source + strlen(kResourceScheme);
+}
+
+bool icon_cache_source_exists(const char* source) {
+  const char* resource_path = icon_cache_resource_path(source);
+  if (resource_path) {
+    return g_resources_get_info(resource_path, G_RESOURCE_LOOKUP_FLAGS_NONE,
+                                nullptr, nullptr, nullptr);
+  }
+  return source && g_file_test(source, G_FILE_TEST_IS_REGULAR);
+}
+
+GdkPixbuf* icon_cache_load_resource(const char* source, int size) {
+  const char* resource_path = icon_cache_resource_path(source);
+  if (!resource_path || size <= 0) {
+    return nullptr;
+  }
+
+  g_autoptr(GError) error = nullptr;
+  GdkPixbuf* pixbuf = gdk_pixbuf_new_from_resource_at_scale(
+      resource_path, size, size, TRUE, &error);
+  if (!pixbuf) {
+    g_warning("Failed to load %s: %s", source, error->message);
+  }
+  return pixbuf;
+}
+
+int icon_cache_scale_factor() {
+  GdkDisplay* display = gdk_display_get_default();
+  if (!display) {
+    return 1;
+  }
+
+  GdkMonitor* monitor = gdk_display_get_primary_monitor(display);
+  if (!monitor) {
+    monitor = gdk_display_get_monitor(display, 0);
+  }
+  return monitor ? gdk_monitor_get_scale_factor(monitor) : 1;
+}
+
+std::string icon_cache_lookup(const char* source, int size) {
+  if (!source || !*source || size <= 0) {
+    return std::string();
+  }
+
+  auto key = std::make_pair(std::string(source), size);
+  std::string stamp = source_stamp(source);
+  auto iter = g_lookups.find(key);
+  if (iter != g_lookups.end() && iter->second.stamp == stamp &&
+      g_file_test(iter->second.path.c_str(), G_FILE_TEST_IS_REGULAR)) {
+    return iter->second.path;
+  }
+
+  // Resolution variants are only looked for next to asset files.
+  std::string selected = icon_cache_resource_path(source)
+                             ? std::string(source)
+                             : select_source(source, size);
+  if (selected.empty()) {
+    return std::string();
+  }
+
+  std::string path = rasterize(selected, size);
+  if (!path.empty()) {
+    g_lookups[key] = Lookup{stamp, path};
+  }
+  return path;
+}
@@ -0,0 +1,42 @@
+#ifndef __ICON_CACHE_H__
+#define __ICON_CACHE_H__
+
+#include <gtk/gtk.h>
+
+#include <string>
+
+// Logical sizes of the tray and menu icons, multiplied by the scale factor to
+// get the pixel sizes that are rasterized.
+constexpr int kTrayIconSize = 22;
+constexpr int kMenuIconSize = 16;
+
+// Sources of the form resource:///path are read from the GResources linked
+// into the process, see SYSTEM_TRAY_ICON_RESOURCES in CMakeLists.txt.
+constexpr char kResourceScheme[] = "resource://";
+
+// Returns the resource path of |source|, or nullptr if it isn't a resource.
+const char* icon_cache_resource_path(const char* source);
+
+// Returns whether |source| names an existing file or resource.
+bool icon_cache_source_exists(const char* source);
+
+// Loads a resource |source| scaled to fit |size| x |size| pixels, without any
+// file I/O. Returns a new reference, or nullptr if it can't be loaded.
+GdkPixbuf* icon_cache_load_resource(const char* source, int size);
+
+// Returns the scale factor of the primary monitor.
+int icon_cache_scale_factor();
+
+// Returns the path of a PNG holding |source| rasterized to fit |size| x |size|
+// pixels. |source| may be any format gdk-pixbuf loads, SVG included; Flutter
+// resolution variants next to it (e.g. `2.0x/icon.png`) are used as better
+// sources for larger sizes.
+//
+// Results are cached under the user cache directory by content hash and
+// size, so each icon is rasterized once per size, and only the most recently
+// used icons are kept there. Files are hashed again when their modification
+// time or size changes; resources are hashed from memory. Returns an empty
+// string if |source| could not be loaded.
+std::string icon_cache_lookup(const char* source, int size);
+
+#endif  // __ICON_CACHE_H__
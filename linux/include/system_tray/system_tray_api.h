@@ -0,0 +1,40 @@
+#ifndef FLUTTER_PLUGIN_SYSTEM_TRAY_API_H_
+#define FLUTTER_PLUGIN_SYSTEM_TRAY_API_H_
+
+#include <stdint.h>
+
+#include "system_tray_plugin.h"
+
+G_BEGIN_DECLS
+
+// Updates the tray from native code, e.g. from worker threads of the runner.
+//
+// These functions may be called from any thread. Updates are queued and
+// applied on the main thread once per main loop iteration; of several updates
+// to the same field before then only the last one is applied. They only take
+// effect once Dart has initialized the tray and, for menu items, set a
+// context menu, and Dart's own MenuItemBase fields aren't updated.
+//
+// Menu items are identified as Menu.buildFrom numbers them: from 1, in the
+// order they appear, a submenu before its children.
+
+// Sets the tray icon, as SystemTray.setImage does.
+FLUTTER_PLUGIN_EXPORT void system_tray_set_icon(const gchar* icon_path);
+
+// Sets the label shown next to the tray icon, as SystemTray.setTitle does.
+FLUTTER_PLUGIN_EXPORT void system_tray_set_label(const gchar* label);
+
+// Update an item of the current context menu.
+FLUTTER_PLUGIN_EXPORT void system_tray_set_menu_item_label(
+    int64_t menu_item_id,
+    const gchar* label);
+FLUTTER_PLUGIN_EXPORT void system_tray_set_menu_item_enabled(
+    int64_t menu_item_id,
+    gboolean enabled);
+FLUTTER_PLUGIN_EXPORT void system_tray_set_menu_item_checked(
+    int64_t menu_item_id,
+    gboolean checked);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_SYSTEM_TRAY_API_H_
@@ -21,6 +21,32 @@ FLUTTER_PLUGIN_EXPORT GType system_tray_plugin_get_type();
 FLUTTER_PLUGIN_EXPORT void system_tray_plugin_register_with_registrar(
     FlPluginRegistrar* registrar);
 
+// Makes |application| single-instance. Call it from
+// GApplication::local_command_line before the Flutter engine is created; the
+// application must not use G_APPLICATION_NON_UNIQUE.
+//
+// In the first instance this registers |application| and returns FALSE, and
+// later launches are delivered to Dart through AppWindow's activation
+// handler. In any other instance |arguments| are forwarded to the running
+// instance over D-Bus and TRUE is returned: the caller should exit right away.
+FLUTTER_PLUGIN_EXPORT gboolean system_tray_plugin_forward_to_primary_instance(
+    GApplication* application,
+    gchar** arguments);
+
+// Returns TRUE if |arguments| contain "--start-hidden", e.g. from an autostart
+// entry.
+FLUTTER_PLUGIN_EXPORT gboolean system_tray_plugin_has_start_hidden_argument(
+    gchar** arguments);
+
+// Starts the application with only the tray, for launches such as autostart
+// at login. Call it from GApplication::activate instead of showing the
+// window, once |view| has been added to it.
+//
+// The view is realized so the engine starts, but the window is neither mapped
+// nor painted until Dart first calls AppWindow.show(). Dart is told when that
+// first show has been drawn through AppWindow's first-shown handler.
+FLUTTER_PLUGIN_EXPORT void system_tray_plugin_start_hidden(FlView* view);
+
 G_END_DECLS
 
 #endif  // FLUTTER_PLUGIN_SYSTEM_TRAY_PLUGIN_H_
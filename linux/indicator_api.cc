@@ -0,0 +1,98 @@
+#include "indicator_api.h"
+
+#include <dlfcn.h>
+
+#include <future>
+#include <mutex>
+
+namespace {
+
+// Both forks share the same ABI, so either one can back the headers we were
+// built against. The one matching the build is tried first.
+constexpr const char* kIndicatorLibraries[] = {
+#ifdef HAVE_AYATANA
+    "libayatana-appindicator3.so.1",
+    "libappindicator3.so.1",
+#else
+    "libappindicator3.so.1",
+    "libayatana-appindicator3.so.1",
+#endif
+};
+
+std::mutex g_mutex;
+std::shared_future<bool> g_load_result;
+IndicatorApi g_indicator_api;
+
+template <typename T>
+bool resolve(void* handle, const char* name, T* fun) {
+  *fun = reinterpret_cast<T>(dlsym(handle, name));
+  return *fun != nullptr;
+}
+
+bool load_indicator_api(IndicatorApi* api) {
+  for (const char* library : kIndicatorLibraries) {
+    void* handle = dlopen(library, RTLD_LAZY | RTLD_LOCAL);
+    if (!handle) {
+      continue;
+    }
+
+    if (resolve(handle, "app_indicator_new", &api->app_indicator_new) &&
+        resolve(handle, "app_indicator_set_status",
+                &api->app_indicator_set_status) &&
+        resolve(handle, "app_indicator_set_icon_full",
+                &api->app_indicator_set_icon_full) &&
+        resolve(handle, "app_indicator_set_attention_icon_full",
+                &api->app_indicator_set_attention_icon_full) &&
+        resolve(handle, "app_indicator_set_label",
+                &api->app_indicator_set_label) &&
+        resolve(handle, "app_indicator_set_title",
+                &api->app_indicator_set_title) &&
+        resolve(handle, "app_indicator_get_label",
+                &api->app_indicator_get_label) &&
+        resolve(handle, "app_indicator_set_menu",
+                &api->app_indicator_set_menu)) {
+      return true;
+    }
+
+    *api = IndicatorApi();
+    dlclose(handle);
+  }
+
+  g_warning("Failed to load %s or %s", kIndicatorLibraries[0],
+            kIndicatorLibraries[1]);
+  return false;
+}
+
+}  // namespace
+
+void indicator_api_preload() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (g_load_result.valid()) {
+    return;
+  }
+
+  g_load_result =
+      std::async(std::launch::async, load_indicator_api, &g_indicator_api)
+          .share();
+}
+
+const IndicatorApi* indicator_api_get() {
+  indicator_api_preload();
+
+  std::shared_future<bool> load_result;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    load_result = g_load_result;
+  }
+
+  return load_result.get() ? &g_indicator_api : nullptr;
+}
+
+void indicator_api_set_for_testing(const IndicatorApi& api) {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_indicator_api = api;
+
+  std::promise<bool> ready;
+  ready.set_value(true);
+  g_load_result = ready.get_future().share();
+}
@@ -0,0 +1,59 @@
+#ifndef __INDICATOR_API_H__
+#define __INDICATOR_API_H__
+
+#include <gtk/gtk.h>
+#ifdef HAVE_AYATANA
+#include <libayatana-appindicator/app-indicator.h>
+#else
+#include <libappindicator/app-indicator.h>
+#endif
+
+typedef AppIndicator* (*app_indicator_new_fun)(const gchar*,
+                                               const gchar*,
+                                               AppIndicatorCategory);
+
+typedef void (*app_indicator_set_status_fun)(AppIndicator*, AppIndicatorStatus);
+typedef void (*app_indicator_set_icon_full_func)(AppIndicator* self,
+                                                 const gchar* icon_name,
+                                                 const gchar* icon_desc);
+typedef void (*app_indicator_set_attention_icon_full_fun)(AppIndicator*,
+                                                          const gchar*,
+                                                          const gchar*);
+typedef void (*app_indicator_set_label_func)(AppIndicator* self,
+                                             const gchar* label,
+                                             const gchar* guide);
+
+typedef void (*app_indicator_set_title_func)(AppIndicator* self,
+                                             const gchar* title);
+
+typedef const gchar* (*app_indicator_get_label_func)(AppIndicator* self);
+
+typedef void (*app_indicator_set_menu_fun)(AppIndicator*, GtkMenu*);
+
+// The appindicator entry points, resolved at runtime so that neither
+// libappindicator nor libdbusmenu are needed to start the process.
+struct IndicatorApi {
+  app_indicator_new_fun app_indicator_new = nullptr;
+  app_indicator_set_status_fun app_indicator_set_status = nullptr;
+  app_indicator_set_icon_full_func app_indicator_set_icon_full = nullptr;
+  app_indicator_set_attention_icon_full_fun
+      app_indicator_set_attention_icon_full = nullptr;
+  app_indicator_set_label_func app_indicator_set_label = nullptr;
+  app_indicator_set_title_func app_indicator_set_title = nullptr;
+  app_indicator_get_label_func app_indicator_get_label = nullptr;
+  app_indicator_set_menu_fun app_indicator_set_menu = nullptr;
+};
+
+// Starts loading the indicator library on a background thread. Calling it
+// more than once has no effect.
+void indicator_api_preload();
+
+// Waits for the load started by indicator_api_preload(), starting it first if
+// needed. Returns nullptr if no usable indicator library was found.
+const IndicatorApi* indicator_api_get();
+
+// Replaces the loaded entry points, e.g. with a headless stand-in in tests.
+// Must be called before the first indicator_api_get().
+void indicator_api_set_for_testing(const IndicatorApi& api);
+
+#endif  // __INDICATOR_API_H__
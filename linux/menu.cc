@@ -2,38 +2,83 @@
 
 #include <memory>
 
+#include "app_window.h"
 #include "errors.h"
+#include "icon_cache.h"
 
 namespace {
 
 constexpr char kMenuIdKey[] = "menu_id";
 constexpr char kMenuItemIdKey[] = "menu_item_id";
 constexpr char kMenuListKey[] = "menu_list";
-constexpr char kIdKey[] = "id";
-constexpr char kTypeKey[] = "type";
-constexpr char kSeparatorKey[] = "separator";
-constexpr char kSubMenuKey[] = "submenu";
-constexpr char kCheckboxKey[] = "checkbox";
+constexpr char kGenerationKey[] = "generation";
 constexpr char kLabelKey[] = "label";
 constexpr char kImageKey[] = "image";
 constexpr char kEnabledKey[] = "enabled";
 constexpr char kCheckedKey[] = "checked";
+constexpr char kDeferUpdatesKey[] = "defer_updates";
+
+// How stale the indicator's menu may get while updates are deferred.
+constexpr guint kFlushUpdatesIntervalMs = 1000;
 
 constexpr char kMenuItemSelectedCallbackMethod[] = "MenuItemSelectedCallback";
 
 struct TrayCallbackData {
   Menu* menu;
   int64_t menu_id;
+  int64_t generation;
   int64_t menu_item_id;
+  std::string native_action;
 };
 
+void free_callback_data(gpointer data, GClosure* closure) {
+  delete reinterpret_cast<TrayCallbackData*>(data);
+}
+
 }  // namespace
 
-Menu::Menu(FlMethodChannel* channel, int menu_id) noexcept
-    : channel_(channel), menu_id_(menu_id) {}
+Menu::Menu(FlMethodChannel* channel,
+           int menu_id,
+           std::weak_ptr<AppWindow> app_window) noexcept
+    : channel_(channel), app_window_(app_window), menu_id_(menu_id) {}
 
 Menu::~Menu() noexcept {
   // printf("~Menu this: %p\n", this);
+  if (flush_updates_timeout_id_ != 0) {
+    g_source_remove(flush_updates_timeout_id_);
+    flush_updates_timeout_id_ = 0;
+  }
+
+  if (gtk_menu_) {
+    g_signal_handlers_disconnect_by_data(gtk_menu_, this);
+    // The indicator may still hold the menu, make sure its items no longer
+    // call into this object.
+    gtk_container_foreach(GTK_CONTAINER(gtk_menu_),
+                          Menu::static_disconnect_menu_item_fun, nullptr);
+    // A GtkMenu is kept alive by its popup toplevel until destroyed.
+    gtk_widget_destroy(gtk_menu_);
+    g_object_unref(gtk_menu_);
+    gtk_menu_ = nullptr;
+  }
+
+  images_.clear();
+  menu_items_.clear();
+}
+
+// static
+void Menu::static_disconnect_menu_item_fun(GtkWidget* widget,
+                                           gpointer user_data) {
+  g_signal_handlers_disconnect_matched(
+      widget, G_SIGNAL_MATCH_FUNC, 0, 0, nullptr,
+      reinterpret_cast<gpointer>(Menu::menu_item_callback), nullptr);
+
+  if (GTK_IS_MENU_ITEM(widget)) {
+    GtkWidget* submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(widget));
+    if (submenu) {
+      gtk_container_foreach(GTK_CONTAINER(submenu),
+                            Menu::static_disconnect_menu_item_fun, user_data);
+    }
+  }
 }
 
 bool Menu::create_context_menu(FlValue* args) {
@@ -49,12 +94,23 @@ bool Menu::create_context_menu(FlValue* args) {
       break;
     }
 
-    GtkWidget* gtk_menu = value_to_menu(menu_id(), list_value);
-    if (!gtk_menu) {
-      break;
+    FlValue* generation_value = fl_value_lookup_string(args, kGenerationKey);
+    if (generation_value &&
+        fl_value_get_type(generation_value) == FL_VALUE_TYPE_INT) {
+      generation_ = fl_value_get_int(generation_value);
     }
 
-    gtk_menu_ = GTK_WIDGET(g_object_ref(gtk_menu));
+    FlValue* defer_updates_value =
+        fl_value_lookup_string(args, kDeferUpdatesKey);
+    if (defer_updates_value &&
+        fl_value_get_type(defer_updates_value) == FL_VALUE_TYPE_BOOL) {
+      defer_updates_ = fl_value_get_bool(defer_updates_value);
+    }
+
+    // The widgets are only built once the menu is shown, see get_menu().
+    if (!fl_menu_model_parse(list_value, &model_)) {
+      break;
+    }
 
     result = true;
 
@@ -90,9 +146,7 @@ FlMethodResponse* Menu::set_label(FlValue* args) {
       label = fl_value_get_string(label_value);
     }
 
-    set_label(menu_item_id, label);
-
-    result = fl_value_new_bool(TRUE);
+    result = fl_value_new_bool(set_label(menu_item_id, label));
 
   } while (false);
 
@@ -130,9 +184,7 @@ FlMethodResponse* Menu::set_image(FlValue* args) {
       image = fl_value_get_string(image_value);
     }
 
-    set_image(menu_item_id, image);
-
-    result = fl_value_new_bool(TRUE);
+    result = fl_value_new_bool(set_image(menu_item_id, image));
 
   } while (false);
 
@@ -166,14 +218,11 @@ FlMethodResponse* Menu::set_enable(FlValue* args) {
 
     bool enable = true;
     FlValue* enable_value = fl_value_lookup_string(args, kEnabledKey);
-    if (enable_value &&
-        fl_value_get_type(enable_value) == FL_VALUE_TYPE_STRING) {
+    if (enable_value && fl_value_get_type(enable_value) == FL_VALUE_TYPE_BOOL) {
       enable = fl_value_get_bool(enable_value);
     }
 
-    set_enable(menu_item_id, enable);
-
-    result = fl_value_new_bool(TRUE);
+    result = fl_value_new_bool(set_enable(menu_item_id, enable));
 
   } while (false);
 
@@ -206,13 +255,11 @@ FlMethodResponse* Menu::set_check(FlValue* args) {
     bool checked = true;
     FlValue* checked_value = fl_value_lookup_string(args, kCheckedKey);
     if (checked_value &&
-        fl_value_get_type(checked_value) == FL_VALUE_TYPE_STRING) {
+        fl_value_get_type(checked_value) == FL_VALUE_TYPE_BOOL) {
       checked = fl_value_get_bool(checked_value);
     }
 
-    set_check(menu_item_id, checked);
-
-    result = fl_value_new_bool(TRUE);
+    result = fl_value_new_bool(set_check(menu_item_id, checked));
 
   } while (false);
 
@@ -223,19 +270,394 @@ FlMethodResponse* Menu::set_check(FlValue* args) {
   return response;
 }
 
-void Menu::set_label(int64_t menu_item_id, const char* label) {}
-void Menu::set_image(int64_t menu_item_id, const char* image) {}
-void Menu::set_enable(int64_t menu_item_id, bool enabled) {}
-void Menu::set_check(int64_t menu_item_id, bool checked) {}
+bool Menu::set_label(int64_t menu_item_id, const char* label) {
+  if (!model_.set_label(menu_item_id, label)) {
+    return false;
+  }
+
+  update_menu_item(menu_item_id, kMenuItemLabelChanged);
+  return true;
+}
+
+bool Menu::set_image(int64_t menu_item_id, const char* image) {
+  if (!model_.set_image(menu_item_id, image)) {
+    return false;
+  }
+
+  update_menu_item(menu_item_id, kMenuItemImageChanged);
+  return true;
+}
+
+bool Menu::set_enable(int64_t menu_item_id, bool enabled) {
+  if (!model_.set_enabled(menu_item_id, enabled)) {
+    return false;
+  }
+
+  update_menu_item(menu_item_id, kMenuItemEnabledChanged);
+  return true;
+}
+
+bool Menu::set_check(int64_t menu_item_id, bool checked) {
+  if (!model_.set_checked(menu_item_id, checked)) {
+    return false;
+  }
+
+  update_menu_item(menu_item_id, kMenuItemCheckedChanged);
+  return true;
+}
+
+void Menu::update_menu_item(int64_t menu_item_id, uint8_t fields) {
+  GtkWidget* menu_item = find_menu_item(menu_item_id);
+  if (!menu_item) {
+    return;
+  }
+
+  if (defer_updates_ && !mapped_) {
+    deferred_updates_[menu_item_id] |= fields;
+    if (!flush_on_show_ && flush_updates_timeout_id_ == 0) {
+      flush_updates_timeout_id_ =
+          g_timeout_add(kFlushUpdatesIntervalMs,
+                        Menu::static_flush_updates_timeout_callback_fun, this);
+    }
+    return;
+  }
+
+  apply_update(menu_item, model_.find(menu_item_id), fields);
+}
+
+void Menu::apply_update(GtkWidget* menu_item, uint32_t index, uint8_t fields) {
+  if (fields & kMenuItemLabelChanged) {
+    update_label(menu_item, model_.label(index));
+  }
+  if (fields & kMenuItemImageChanged) {
+    update_image(menu_item, model_.image(index));
+  }
+  if (fields & kMenuItemEnabledChanged) {
+    gtk_widget_set_sensitive(menu_item, model_.enabled(index) ? TRUE : FALSE);
+  }
+  // Checking a radio item unchecks the rest of its group, and GTK doesn't
+  // uncheck one that is still the group's only checked item.
+  if ((fields & kMenuItemCheckedChanged) &&
+      (model_.checked(index) || model_.type(index) != MenuItemType::kRadio)) {
+    update_check(menu_item, model_.checked(index));
+  }
+}
+
+void Menu::flush_updates() {
+  if (flush_updates_timeout_id_ != 0) {
+    g_source_remove(flush_updates_timeout_id_);
+    flush_updates_timeout_id_ = 0;
+  }
+
+  std::unordered_map<int64_t, uint8_t> updates;
+  updates.swap(deferred_updates_);
+  for (const auto& iter : updates) {
+    GtkWidget* menu_item = find_menu_item(iter.first);
+    if (menu_item) {
+      apply_update(menu_item, model_.find(iter.first), iter.second);
+    }
+  }
+}
+
+void Menu::set_flush_on_show(bool flush_on_show) {
+  flush_on_show_ = flush_on_show;
+  if (flush_on_show_ && flush_updates_timeout_id_ != 0) {
+    g_source_remove(flush_updates_timeout_id_);
+    flush_updates_timeout_id_ = 0;
+  }
+}
+
+// static
+gboolean Menu::static_flush_updates_timeout_callback_fun(gpointer user_data) {
+  Menu* self = reinterpret_cast<Menu*>(user_data);
+  self->flush_updates_timeout_id_ = 0;
+  self->flush_updates();
+  return G_SOURCE_REMOVE;
+}
+
+// static
+void Menu::static_menu_map_callback_fun(GtkWidget* widget, Menu* self) {
+  // Popups from Tray::popup_context_menu() are flushed before being laid out,
+  // this catches any other.
+  self->mapped_ = true;
+  self->flush_updates();
+}
+
+// static
+void Menu::static_menu_unmap_callback_fun(GtkWidget* widget, Menu* self) {
+  self->mapped_ = false;
+}
+
+void Menu::connect_menu() {
+  // Only the top-level menu is tracked, a submenu can't be open without it.
+  g_signal_connect(gtk_menu_, "map",
+                   G_CALLBACK(Menu::static_menu_map_callback_fun), this);
+  g_signal_connect(gtk_menu_, "unmap",
+                   G_CALLBACK(Menu::static_menu_unmap_callback_fun), this);
+}
+
+void Menu::update_label(GtkWidget* menu_item, const char* label) {
+  GtkWidget* label_widget = find_child(menu_item, GTK_TYPE_LABEL);
+  if (label_widget && !GTK_IS_ACCEL_LABEL(label_widget)) {
+    // An item with an image, see render_menu_item.
+    gtk_label_set_text(GTK_LABEL(label_widget), label ? label : "");
+  } else {
+    gtk_menu_item_set_label(GTK_MENU_ITEM(menu_item), label ? label : "");
+  }
+}
+
+void Menu::update_image(GtkWidget* menu_item, const char* image) {
+  GtkWidget* image_widget = find_child(menu_item, GTK_TYPE_IMAGE);
+  if (!image || !*image) {
+    if (image_widget) {
+      gtk_widget_hide(image_widget);
+    }
+    return;
+  }
+
+  if (!image_widget) {
+    // Swap the plain label for the box items with an image are built with.
+    g_autofree gchar* label =
+        g_strdup(gtk_menu_item_get_label(GTK_MENU_ITEM(menu_item)));
+    GtkWidget* child = gtk_bin_get_child(GTK_BIN(menu_item));
+    if (child) {
+      gtk_container_remove(GTK_CONTAINER(menu_item), child);
+    }
+
+    GtkWidget* box_widget = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    image_widget = new_image_widget(image);
+    gtk_container_add(GTK_CONTAINER(box_widget), image_widget);
+    gtk_container_add(GTK_CONTAINER(box_widget), gtk_label_new(label));
+    gtk_container_add(GTK_CONTAINER(menu_item), box_widget);
+    gtk_widget_show_all(menu_item);
+    return;
+  }
+
+  cairo_surface_t* surface = load_image_surface(image);
+  if (surface) {
+    gtk_image_set_from_surface(GTK_IMAGE(image_widget), surface);
+    cairo_surface_destroy(surface);
+  } else {
+    gtk_image_set_from_file(GTK_IMAGE(image_widget), image);
+  }
+  gtk_widget_show(image_widget);
+
+  for (auto& iter : images_) {
+    if (iter.first == GTK_IMAGE(image_widget)) {
+      iter.second = image;
+    }
+  }
+}
+
+// static
+void Menu::update_check(GtkWidget* menu_item, bool checked) {
+  if (!GTK_IS_CHECK_MENU_ITEM(menu_item)) {
+    return;
+  }
+
+  // Toggling a check item activates it, which isn't a click to report.
+  g_signal_handlers_block_matched(
+      menu_item, G_SIGNAL_MATCH_FUNC, 0, 0, nullptr,
+      reinterpret_cast<gpointer>(Menu::menu_item_callback), nullptr);
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(menu_item),
+                                 checked ? TRUE : FALSE);
+  g_signal_handlers_unblock_matched(
+      menu_item, G_SIGNAL_MATCH_FUNC, 0, 0, nullptr,
+      reinterpret_cast<gpointer>(Menu::menu_item_callback), nullptr);
+}
+
+bool Menu::activate_menu_item(int64_t menu_item_id) {
+  get_menu();
+
+  // Submenu items are only kept to be updated, they aren't clicked.
+  uint32_t index = model_.find(menu_item_id);
+  if (index == kNoMenuItem || model_.type(index) == MenuItemType::kSubMenu) {
+    return false;
+  }
+
+  GtkWidget* menu_item = find_menu_item(menu_item_id);
+  if (!menu_item) {
+    return false;
+  }
+
+  gtk_menu_item_activate(GTK_MENU_ITEM(menu_item));
+  return true;
+}
+
+GtkWidget* Menu::find_menu_item(int64_t menu_item_id) const {
+  auto iter = menu_items_.find(menu_item_id);
+  return iter != menu_items_.end() ? iter->second : nullptr;
+}
+
+// static
+GtkWidget* Menu::find_child(GtkWidget* widget, GType type) {
+  if (G_TYPE_CHECK_INSTANCE_TYPE(widget, type)) {
+    return widget;
+  }
+
+  if (!GTK_IS_CONTAINER(widget)) {
+    return nullptr;
+  }
+
+  GtkWidget* result = nullptr;
+  GList* children = gtk_container_get_children(GTK_CONTAINER(widget));
+  for (GList* iter = children; iter && !result; iter = iter->next) {
+    result = find_child(GTK_WIDGET(iter->data), type);
+  }
+  g_list_free(children);
+  return result;
+}
 
 int64_t Menu::menu_id() const {
   return menu_id_;
 }
 
-GtkWidget* Menu::get_menu() const {
+GtkWidget* Menu::get_menu() {
+  if (!gtk_menu_) {
+    gtk_menu_ = GTK_WIDGET(g_object_ref_sink(render_menu(0, model_.size())));
+    connect_menu();
+  }
   return gtk_menu_;
 }
 
+const MenuModel& Menu::get_model() const {
+  return model_;
+}
+
+FlValue* Menu::create_menu_list() const {
+  return fl_menu_model_to_value(model_);
+}
+
+std::string Menu::get_label(int64_t menu_item_id) const {
+  uint32_t index = model_.find(menu_item_id);
+  return index != kNoMenuItem ? model_.label(index) : "";
+}
+
+bool Menu::adopt_widgets(Menu* previous) {
+  if (gtk_menu_ || !previous->gtk_menu_) {
+    return false;
+  }
+
+  std::vector<MenuModelChange> changes;
+  if (!MenuModel::diff(previous->model_, model_, &changes)) {
+    return false;
+  }
+
+  std::swap(gtk_menu_, previous->gtk_menu_);
+  menu_items_.swap(previous->menu_items_);
+  images_.swap(previous->images_);
+
+  g_signal_handlers_disconnect_by_data(gtk_menu_, previous);
+  connect_menu();
+  mapped_ = previous->mapped_;
+
+  // The widgets still lack the updates |previous| deferred, which model_
+  // has as well.
+  for (const auto& iter : previous->deferred_updates_) {
+    update_menu_item(iter.first, iter.second);
+  }
+  previous->deferred_updates_.clear();
+
+  // Clicks must be reported with this menu's id, generation and actions.
+  gtk_container_foreach(GTK_CONTAINER(gtk_menu_),
+                        Menu::static_disconnect_menu_item_fun, nullptr);
+  for (const auto& iter : menu_items_) {
+    uint32_t index = model_.find(iter.first);
+    if (model_.type(index) != MenuItemType::kSubMenu) {
+      connect_menu_item(iter.second, index);
+    }
+  }
+
+  for (const MenuModelChange& change : changes) {
+    update_menu_item(model_.id(change.index), change.fields);
+  }
+  return true;
+}
+
+void Menu::set_queue_clicks(bool queue_clicks) {
+  queue_clicks_ = queue_clicks;
+}
+
+std::vector<int64_t> Menu::take_queued_clicks() {
+  std::vector<int64_t> clicks;
+  clicks.swap(queued_clicks_);
+  return clicks;
+}
+
+void Menu::prepare_popup() {
+  if (gtk_menu_) {
+    prepare_menu(gtk_menu_);
+  }
+}
+
+// static
+void Menu::prepare_menu(GtkWidget* menu) {
+  gtk_widget_realize(menu);
+
+  // Resolves styles and caches the size request of every item.
+  GtkRequisition natural_size;
+  gtk_widget_get_preferred_size(menu, nullptr, &natural_size);
+
+  g_autoptr(GList) children = gtk_container_get_children(GTK_CONTAINER(menu));
+  for (GList* iter = children; iter; iter = iter->next) {
+    if (!GTK_IS_MENU_ITEM(iter->data)) {
+      continue;
+    }
+
+    GtkWidget* submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(iter->data));
+    if (submenu) {
+      prepare_menu(submenu);
+    }
+  }
+}
+
+void Menu::refresh_images() {
+  for (auto& image : images_) {
+    cairo_surface_t* surface = load_image_surface(image.second.c_str());
+    if (surface) {
+      gtk_image_set_from_surface(image.first, surface);
+      cairo_surface_destroy(surface);
+    }
+  }
+}
+
+GtkWidget* Menu::new_image_widget(const char* image) {
+  cairo_surface_t* surface = load_image_surface(image);
+  GtkWidget* image_widget = surface ? gtk_image_new_from_surface(surface)
+                                    : gtk_image_new_from_file(image);
+  if (surface) {
+    cairo_surface_destroy(surface);
+  }
+  images_.emplace_back(GTK_IMAGE(image_widget), image);
+  return image_widget;
+}
+
+cairo_surface_t* Menu::load_image_surface(const char* image) {
+  g_autoptr(GdkPixbuf) pixbuf = load_image(image);
+  if (!pixbuf) {
+    return nullptr;
+  }
+
+  // Pixbufs are shown at one image pixel per device pixel, so the icon
+  // loaded at kMenuIconSize * scale would be drawn that many times larger.
+  return gdk_cairo_surface_create_from_pixbuf(
+      pixbuf, icon_cache_scale_factor(), nullptr);
+}
+
+GdkPixbuf* Menu::load_image(const char* image) {
+  int size = kMenuIconSize * icon_cache_scale_factor();
+  if (icon_cache_resource_path(image)) {
+    // Decoded straight from memory, no rasterized copy is needed.
+    return icon_cache_load_resource(image, size);
+  }
+
+  std::string path = icon_cache_lookup(image, size);
+  if (path.empty()) {
+    return nullptr;
+  }
+  return gdk_pixbuf_new_from_file(path.c_str(), nullptr);
+}
+
 // static
 void Menu::menu_item_callback(GtkMenuItem* item, gpointer user_data) {
   TrayCallbackData* callback_data =
@@ -249,131 +671,135 @@ void Menu::handle_menu_item_callback(GtkMenuItem* item, gpointer user_data) {
   TrayCallbackData* callback_data =
       reinterpret_cast<TrayCallbackData*>(user_data);
 
+  // GTK has toggled the item already, the model follows it.
+  uint32_t index = model_.find(callback_data->menu_item_id);
+  bool toggle = index != kNoMenuItem && GTK_IS_CHECK_MENU_ITEM(item);
+  if (toggle) {
+    bool active = gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(item));
+    if (GTK_IS_RADIO_MENU_ITEM(item) && !active) {
+      // Selecting a radio item activates the one it replaces as well, which
+      // isn't a click.
+      return;
+    }
+    model_.set_checked(callback_data->menu_item_id, active);
+  }
+
   // g_print("handle_menu_item_callback menu_id:%ld, menu_item_id:%ld\n",
   //         callback_data->menu_id, callback_data->menu_item_id);
 
+  if (queue_clicks_) {
+    queued_clicks_.push_back(callback_data->menu_item_id);
+    return;
+  }
+
+  // Run before Dart is told, so the window responds even while the isolate
+  // is busy.
+  if (!callback_data->native_action.empty()) {
+    std::shared_ptr<AppWindow> app_window = app_window_.lock();
+    if (app_window) {
+      app_window->run_native_action(callback_data->native_action.c_str());
+    }
+  }
+
   g_autoptr(FlValue) result = fl_value_new_map();
   fl_value_set_string_take(result, kMenuIdKey,
                            fl_value_new_int(callback_data->menu_id));
+  fl_value_set_string_take(result, kGenerationKey,
+                           fl_value_new_int(callback_data->generation));
   fl_value_set_string_take(result, kMenuItemIdKey,
                            fl_value_new_int(callback_data->menu_item_id));
-  fl_method_channel_invoke_method(channel_, kMenuItemSelectedCallbackMethod,
-                                  result, nullptr, nullptr, nullptr);
-}
-
-GtkWidget* Menu::value_to_menu(int64_t menu_id, FlValue* value) {
-  if (fl_value_get_type(value) != FL_VALUE_TYPE_LIST) {
-    return nullptr;
+  if (toggle) {
+    // Dart updates the item from this, without calling SetCheck back.
+    fl_value_set_string_take(result, kCheckedKey,
+                             fl_value_new_bool(model_.checked(index)));
   }
-
-  GtkWidget* menu = gtk_menu_new();
-
-  for (size_t i = 0; i < fl_value_get_length(value); ++i) {
-    GtkWidget* menu_item =
-        value_to_menu_item(menu_id, fl_value_get_list_value(value, i));
-    if (menu_item == nullptr) {
-      return nullptr;
-    }
-
-    gtk_menu_shell_append(GTK_MENU_SHELL(menu), GTK_WIDGET(menu_item));
+  // Replayed traces have no channel.
+  if (channel_) {
+    fl_method_channel_invoke_method(channel_, kMenuItemSelectedCallbackMethod,
+                                    result, nullptr, nullptr, nullptr);
   }
-  return GTK_WIDGET(menu);
 }
 
-GtkWidget* Menu::value_to_menu_item(int64_t menu_id, FlValue* value) {
-  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
-    return nullptr;
+GtkWidget* Menu::render_menu(uint32_t begin, uint32_t end) {
+  GtkWidget* menu = gtk_menu_new();
+  // The previous item if it is a radio item, whose group the next one joins.
+  GtkWidget* radio_group = nullptr;
+  for (uint32_t i = begin; i < end; i = model_.end(i)) {
+    GtkWidget* menu_item = render_menu_item(i, radio_group);
+    radio_group = GTK_IS_RADIO_MENU_ITEM(menu_item) ? menu_item : nullptr;
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
   }
+  return menu;
+}
 
-  FlValue* type_value = fl_value_lookup_string(value, kTypeKey);
-  if (type_value == nullptr ||
-      fl_value_get_type(type_value) != FL_VALUE_TYPE_STRING) {
-    return nullptr;
+GtkWidget* Menu::render_menu_item(uint32_t index, GtkWidget* radio_group) {
+  MenuItemType type = model_.type(index);
+  if (type == MenuItemType::kSeparator) {
+    return gtk_separator_menu_item_new();
   }
 
   GtkWidget* menu_item = nullptr;
-
-  const gchar* type = fl_value_get_string(type_value);
-
-  if (strcmp(type, kSeparatorKey) == 0) {
-    menu_item = gtk_separator_menu_item_new();
+  const char* label = model_.label(index);
+  const char* image = model_.image(index);
+
+  if (type == MenuItemType::kCheckbox) {
+    menu_item = gtk_check_menu_item_new();
+  } else if (type == MenuItemType::kRadio) {
+    menu_item = gtk_radio_menu_item_new_from_widget(
+        radio_group ? GTK_RADIO_MENU_ITEM(radio_group) : nullptr);
   } else {
-    const gchar* label = nullptr;
-    FlValue* label_value = fl_value_lookup_string(value, kLabelKey);
-    if (label_value != nullptr &&
-        fl_value_get_type(label_value) == FL_VALUE_TYPE_STRING) {
-      label = fl_value_get_string(label_value);
-    }
-
-    FlValue* image_value = fl_value_lookup_string(value, kImageKey);
-    if (image_value != nullptr &&
-        fl_value_get_type(image_value) == FL_VALUE_TYPE_STRING) {
-      const gchar* image = fl_value_get_string(image_value);
-
-      // g_print("value_to_menu_item type:%s, label:%s, image:%s\n", type,
-      // label, image);
+    menu_item = gtk_menu_item_new();
+  }
 
-      menu_item = gtk_menu_item_new();
+  if (*image) {
+    GtkWidget* box_widget = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget* icon_widget = new_image_widget(image);
+    GtkWidget* label_widget = gtk_label_new(label);
 
-      GtkWidget* box_widget = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
-      GtkWidget* icon_widget = gtk_image_new_from_file(image);
-      GtkWidget* label_widget = gtk_label_new(label);
+    gtk_container_add(GTK_CONTAINER(box_widget), icon_widget);
+    gtk_container_add(GTK_CONTAINER(box_widget), label_widget);
+    gtk_container_add(GTK_CONTAINER(menu_item), box_widget);
 
-      gtk_container_add(GTK_CONTAINER(box_widget), icon_widget);
-      gtk_container_add(GTK_CONTAINER(box_widget), label_widget);
-      gtk_container_add(GTK_CONTAINER(menu_item), box_widget);
+    gtk_widget_show_all(menu_item);
+  } else {
+    gtk_menu_item_set_label(GTK_MENU_ITEM(menu_item), label);
+  }
 
-      gtk_widget_show_all(menu_item);
-    } else {
-      g_print("value_to_menu_item type:%s, label:%s\n", type, label);
-    }
+  if (!model_.enabled(index)) {
+    gtk_widget_set_sensitive(menu_item, FALSE);
+  }
 
-    if (!menu_item) {
-      if (strcmp(type, kCheckboxKey) == 0) {
-        menu_item = gtk_check_menu_item_new_with_label(label);
-      } else {
-        menu_item = gtk_menu_item_new_with_label(label);
-      }
-    }
+  int64_t menu_item_id = model_.id(index);
+  if (menu_item_id >= 0) {
+    menu_items_[menu_item_id] = menu_item;
+  }
 
-    FlValue* enabled_value = fl_value_lookup_string(value, kEnabledKey);
-    if (enabled_value != nullptr &&
-        fl_value_get_type(enabled_value) == FL_VALUE_TYPE_BOOL) {
-      gtk_widget_set_sensitive(menu_item,
-                               fl_value_get_bool(enabled_value) ? TRUE : FALSE);
-    }
+  if (type == MenuItemType::kSubMenu) {
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_item),
+                              render_menu(index + 1, model_.end(index)));
+    return menu_item;
+  }
 
-    if (strcmp(type, kSubMenuKey) == 0) {
-      GtkWidget* subMenu =
-          value_to_menu(menu_id, fl_value_lookup_string(value, kSubMenuKey));
-      if (subMenu == nullptr) {
-        return nullptr;
-      }
-      gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_item), subMenu);
-    } else {
-      if (strcmp(type, kCheckboxKey) == 0) {
-        FlValue* checked_value = fl_value_lookup_string(value, kCheckedKey);
-        if (checked_value &&
-            fl_value_get_type(checked_value) == FL_VALUE_TYPE_BOOL) {
-          bool checked = fl_value_get_bool(checked_value);
-          gtk_check_menu_item_set_active(
-              reinterpret_cast<GtkCheckMenuItem*>(menu_item), checked);
-        }
-      }
-
-      FlValue* id_value = fl_value_lookup_string(value, kIdKey);
-      if (id_value != nullptr &&
-          fl_value_get_type(id_value) == FL_VALUE_TYPE_INT) {
-        TrayCallbackData* callback_data = new TrayCallbackData();
-        callback_data->menu = this;
-        callback_data->menu_id = menu_id;
-        callback_data->menu_item_id = fl_value_get_int(id_value);
-
-        g_signal_connect(G_OBJECT(menu_item), "activate",
-                         G_CALLBACK(Menu::menu_item_callback), callback_data);
-      }
-    }
+  if (GTK_IS_CHECK_MENU_ITEM(menu_item)) {
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(menu_item),
+                                   model_.checked(index) ? TRUE : FALSE);
   }
 
+  if (menu_item_id >= 0) {
+    connect_menu_item(menu_item, index);
+  }
   return menu_item;
-}
\ No newline at end of file
+}
+
+void Menu::connect_menu_item(GtkWidget* menu_item, uint32_t index) {
+  TrayCallbackData* callback_data = new TrayCallbackData();
+  callback_data->menu = this;
+  callback_data->menu_id = menu_id();
+  callback_data->generation = generation_;
+  callback_data->menu_item_id = model_.id(index);
+  callback_data->native_action = model_.native_action(index);
+
+  g_signal_connect_data(G_OBJECT(menu_item), "activate",
+                        G_CALLBACK(Menu::menu_item_callback), callback_data,
+                        free_callback_data, static_cast<GConnectFlags>(0));
+}
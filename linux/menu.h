@@ -4,10 +4,20 @@
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "fl_menu_model.h"
+
+class AppWindow;
 
 class Menu {
  public:
-  Menu(FlMethodChannel* channel, int menu_id) noexcept;
+  Menu(FlMethodChannel* channel,
+       int menu_id,
+       std::weak_ptr<AppWindow> app_window) noexcept;
   ~Menu() noexcept;
 
   bool create_context_menu(FlValue* args);
@@ -16,28 +26,123 @@ class Menu {
   FlMethodResponse* set_enable(FlValue* args);
   FlMethodResponse* set_check(FlValue* args);
 
-  GtkWidget* get_menu() const;
+  // Builds the widgets on first use.
+  GtkWidget* get_menu();
+
+  const MenuModel& get_model() const;
+
+  // Returns the menu_list representation of the menu, with the changes made
+  // since it was created.
+  FlValue* create_menu_list() const;
+
+  // Takes over the widgets of |previous| if both menus have the same
+  // structure and only updates the items that differ, so the indicator keeps
+  // the menu it already exports. Returns false, leaving both menus as they
+  // were, if this menu was already built or the structures differ.
+  bool adopt_widgets(Menu* previous);
+
+  // Returns the label of an item, or an empty string if there is no such item.
+  std::string get_label(int64_t menu_item_id) const;
+
+  // While set, clicks are kept instead of being sent to Dart, e.g. for a menu
+  // restored before Dart runs. take_queued_clicks() returns and clears them.
+  void set_queue_clicks(bool queue_clicks);
+  std::vector<int64_t> take_queued_clicks();
+
+  // Realizes the menu and its submenus and computes their sizes, so the first
+  // popup costs no more than later ones.
+  void prepare_popup();
+
+  // Update an item as the method calls of the same name do. Return false if
+  // there is no such item.
+  bool set_label(int64_t menu_item_id, const char* label);
+  bool set_image(int64_t menu_item_id, const char* image);
+  bool set_enable(int64_t menu_item_id, bool enabled);
+  bool set_check(int64_t menu_item_id, bool checked);
+
+  // Activates an item as if it was clicked, for tests.
+  bool activate_menu_item(int64_t menu_item_id);
+
+  // Applies the updates deferred while the menu was closed, see
+  // defer_updates_.
+  void flush_updates();
+
+  // Set when the panel tells before it opens the menu, see
+  // Tray::connect_menu_root(). Deferred updates then wait for that instead
+  // of being applied periodically.
+  void set_flush_on_show(bool flush_on_show);
+
+  void refresh_images();
 
  protected:
-  GtkWidget* value_to_menu(int64_t menu_id, FlValue* value);
-  GtkWidget* value_to_menu_item(int64_t menu_id, FlValue* value);
+  // Builds the widgets for the items from |begin| up to |end| of model_.
+  GtkWidget* render_menu(uint32_t begin, uint32_t end);
+  GtkWidget* render_menu_item(uint32_t index, GtkWidget* radio_group);
+  void connect_menu_item(GtkWidget* menu_item, uint32_t index);
+  void connect_menu();
+
+  // Updates the |fields| of an item's widget from model_, or defers it until
+  // the menu is shown.
+  void update_menu_item(int64_t menu_item_id, uint8_t fields);
+  void apply_update(GtkWidget* menu_item, uint32_t index, uint8_t fields);
+
+  static void static_menu_map_callback_fun(GtkWidget* widget, Menu* self);
+  static void static_menu_unmap_callback_fun(GtkWidget* widget, Menu* self);
+  static gboolean static_flush_updates_timeout_callback_fun(gpointer user_data);
 
   static void menu_item_callback(GtkMenuItem* item, gpointer user_data);
+  static void static_disconnect_menu_item_fun(GtkWidget* widget,
+                                              gpointer user_data);
   void handle_menu_item_callback(GtkMenuItem* item, gpointer user_data);
 
   int64_t menu_id() const;
 
-  void set_label(int64_t menu_item_id, const char* label);
-  void set_image(int64_t menu_item_id, const char* image);
-  void set_enable(int64_t menu_item_id, bool enabled);
-  void set_check(int64_t menu_item_id, bool checked);
+  GtkWidget* new_image_widget(const char* image);
+  // Returns a new reference, or nullptr if the image can't be loaded.
+  GdkPixbuf* load_image(const char* image);
+  // Returns a new surface of the image at the monitor's scale factor.
+  cairo_surface_t* load_image_surface(const char* image);
+
+  void update_label(GtkWidget* menu_item, const char* label);
+  void update_image(GtkWidget* menu_item, const char* image);
+  static void update_check(GtkWidget* menu_item, bool checked);
+
+  GtkWidget* find_menu_item(int64_t menu_item_id) const;
+  static GtkWidget* find_child(GtkWidget* widget, GType type);
+  static void prepare_menu(GtkWidget* menu);
 
  protected:
   FlMethodChannel* channel_ = nullptr;
+  // Runs the native actions of items, see NativeMenuAction in Dart.
+  std::weak_ptr<AppWindow> app_window_;
 
   int64_t menu_id_ = -1;
+  int64_t generation_ = 0;
 
+  MenuModel model_;
   GtkWidget* gtk_menu_ = nullptr;
+
+  // While set, widget updates are deferred until the menu is about to be
+  // shown, keeping only which fields of which items changed since model_ has
+  // their latest values. Menus whose items change many times a second then
+  // cost little while closed. The panel opens the indicator's menu without
+  // mapping it here; it sends about-to-show over dbusmenu instead, see
+  // flush_on_show_. Where that isn't available, the updates are applied
+  // every kFlushUpdatesIntervalMs.
+  bool defer_updates_ = false;
+  bool flush_on_show_ = false;
+  bool mapped_ = false;
+  std::unordered_map<int64_t, uint8_t> deferred_updates_;
+  guint flush_updates_timeout_id_ = 0;
+
+  bool queue_clicks_ = false;
+  std::vector<int64_t> queued_clicks_;
+
+  // Items with an id, owned by gtk_menu_ once it is built.
+  std::unordered_map<int64_t, GtkWidget*> menu_items_;
+
+  // Image widgets of the menu and the image they were created from.
+  std::vector<std::pair<GtkImage*, std::string>> images_;
 };
 
 #endif  // __MENU_H__
\ No newline at end of file
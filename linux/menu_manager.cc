@@ -23,10 +23,19 @@ MenuManager::~MenuManager() noexcept {
 }
 
 void MenuManager::handle_method_call(FlMethodCall* method_call) {
-  g_autoptr(FlMethodResponse) response = nullptr;
+  g_autoptr(FlMethodResponse) response =
+      handle_method(fl_method_call_get_name(method_call),
+                    fl_method_call_get_args(method_call));
 
-  const gchar* method = fl_method_call_get_name(method_call);
-  FlValue* args = fl_method_call_get_args(method_call);
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+FlMethodResponse* MenuManager::handle_method(const gchar* method,
+                                             FlValue* args) {
+  FlMethodResponse* response = nullptr;
 
   // g_print("method call %s\n", method);
 
@@ -44,10 +53,7 @@ void MenuManager::handle_method_call(FlMethodCall* method_call) {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
 
-  g_autoptr(GError) error = nullptr;
-  if (!fl_method_call_respond(method_call, response, &error)) {
-    g_warning("Failed to send method call response: %s", error->message);
-  }
+  return response;
 }
 
 FlMethodResponse* MenuManager::create_context_menu(FlValue* args) {
@@ -71,7 +77,8 @@ FlMethodResponse* MenuManager::create_context_menu(FlValue* args) {
 
     int64_t menu_id = fl_value_get_int(menu_id_value);
 
-    std::unique_ptr<Menu> menu = std::make_unique<Menu>(channel_, menu_id);
+    std::unique_ptr<Menu> menu =
+        std::make_unique<Menu>(channel_, menu_id, app_window_);
     if (!menu) {
       response = FL_METHOD_RESPONSE(
           fl_method_error_response_new(errors::kOutOfMemoryError, "", nullptr));
@@ -195,8 +202,12 @@ FlMethodResponse* MenuManager::set_check(FlValue* args) {
   return response;
 }
 
+void MenuManager::set_app_window(std::weak_ptr<AppWindow> app_window) {
+  app_window_ = app_window;
+}
+
 bool MenuManager::add_menu(int64_t menu_id, std::unique_ptr<Menu> menu) {
-  menus_map_.emplace(menu_id, std::move(menu));
+  menus_map_[menu_id] = std::move(menu);
   return true;
 }
 
@@ -205,6 +216,16 @@ std::shared_ptr<Menu> MenuManager::get_menu(int64_t menu_id) {
   return (iter != menus_map_.end()) ? iter->second : nullptr;
 }
 
+void MenuManager::remove_menu(int64_t menu_id) {
+  menus_map_.erase(menu_id);
+}
+
+void MenuManager::refresh_images() {
+  for (auto& iter : menus_map_) {
+    iter.second->refresh_images();
+  }
+}
+
 std::shared_ptr<Menu> MenuManager::get_menu(FlValue* args) {
   std::shared_ptr<Menu> menu;
 
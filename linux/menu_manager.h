@@ -12,6 +12,7 @@ extern const char kSetImage[];
 extern const char kSetEnable[];
 extern const char kSetCheck[];
 
+class AppWindow;
 class Menu;
 
 class MenuManager {
@@ -21,7 +22,18 @@ class MenuManager {
 
   void handle_method_call(FlMethodCall* method_call);
 
+  // Runs |method| with |args| and returns the response for Dart, e.g. for
+  // replaying recorded calls without a method channel.
+  FlMethodResponse* handle_method(const gchar* method, FlValue* args);
+
+  // The window native menu actions run against.
+  void set_app_window(std::weak_ptr<AppWindow> app_window);
+
   std::shared_ptr<Menu> get_menu(int64_t menu_id);
+  void remove_menu(int64_t menu_id);
+
+  // Reloads menu images at the current scale factor.
+  void refresh_images();
 
  protected:
   FlMethodResponse* create_context_menu(FlValue* args);
@@ -36,6 +48,7 @@ class MenuManager {
 
  protected:
   FlMethodChannel* channel_ = nullptr;
+  std::weak_ptr<AppWindow> app_window_;
 
   std::unordered_map<int64_t, std::shared_ptr<Menu>> menus_map_;
 };
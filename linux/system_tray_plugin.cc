@@ -1,4 +1,5 @@
 #include "include/system_tray/system_tray_plugin.h"
+#include "include/system_tray/system_tray_api.h"
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
@@ -6,10 +7,21 @@
 
 #include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "app_window.h"
+#include "errors.h"
+#include "indicator_api.h"
+#include "menu.h"
 #include "menu_manager.h"
+#include "trace.h"
 #include "tray.h"
+#include "tray_update_queue.h"
+
+#ifdef SYSTEM_TRAY_TESTING
+#include "headless_indicator.h"
+#endif
 
 namespace {
 
@@ -17,6 +29,32 @@ constexpr char kChannelNameAppWindow[] = "flutter/system_tray/app_window";
 constexpr char kChannelNameMenuManager[] = "flutter/system_tray/menu_manager";
 constexpr char kChannelNameTray[] = "flutter/system_tray/tray";
 
+#ifdef SYSTEM_TRAY_TESTING
+// Only registered with the headless indicator, for the example's integration
+// tests to observe the tray and click menu items. Built only along with the
+// example's tests, see SYSTEM_TRAY_TESTING in CMakeLists.txt.
+constexpr char kChannelNameTesting[] = "flutter/system_tray/testing";
+constexpr char kGetIndicatorState[] = "GetIndicatorState";
+constexpr char kActivateMenuItem[] = "ActivateMenuItem";
+
+constexpr char kVisibleKey[] = "visible";
+constexpr char kVisibleUptimeUsKey[] = "visible_uptime_us";
+constexpr char kMenuIdKey[] = "menu_id";
+constexpr char kMenuItemIdKey[] = "menu_item_id";
+#endif
+
+// Action the other instances activate on the first one, with their command
+// line as parameter.
+constexpr char kForwardActionName[] = "system-tray-forward";
+
+constexpr char kStartHiddenArgument[] = "--start-hidden";
+
+// Launches forwarded before the plugin was registered.
+std::vector<std::vector<std::string>> g_pending_activations;
+
+// Updates made through system_tray_api.h, from any thread.
+TrayUpdateQueue g_tray_updates;
+
 }  // namespace
 
 #define SYSTEM_TRAY_PLUGIN(obj)                                     \
@@ -31,10 +69,16 @@ struct _SystemTrayPlugin {
   FlMethodChannel* channel_app_window = nullptr;
   FlMethodChannel* channel_menu_manager = nullptr;
   FlMethodChannel* channel_tray = nullptr;
+#ifdef SYSTEM_TRAY_TESTING
+  FlMethodChannel* channel_testing = nullptr;
+#endif
 
-  std::unique_ptr<AppWindow> app_window;
+  std::shared_ptr<AppWindow> app_window;
   std::shared_ptr<MenuManager> menu_manager;
   std::unique_ptr<Tray> tray;
+
+  // Set when SYSTEM_TRAY_TRACE names a file to record method calls to.
+  std::unique_ptr<TraceWriter> trace_writer;
 };
 
 G_DEFINE_TYPE(SystemTrayPlugin, system_tray_plugin, g_object_get_type())
@@ -53,7 +97,12 @@ static void system_tray_plugin_handle_method_call(SystemTrayPlugin* self,
   if (strcmp(method, kInitAppWindow) == 0 ||
       strcmp(method, kShowAppWindow) == 0 ||
       strcmp(method, kHideAppWindow) == 0 ||
-      strcmp(method, kCloseAppWindow) == 0) {
+      strcmp(method, kCloseAppWindow) == 0 ||
+      strcmp(method, kSetBackgroundMode) == 0 ||
+      strcmp(method, kGetBackgroundStats) == 0 ||
+      strcmp(method, kSetRestoreMode) == 0 ||
+      strcmp(method, kGetShowLatency) == 0 ||
+      strcmp(method, kSetCloseToTray) == 0) {
     self->app_window->handle_method_call(method_call);
   } else if (strcmp(method, kCreateContextMenu) == 0 ||
              strcmp(method, kSetLabel) == 0 || strcmp(method, kSetImage) == 0 ||
@@ -65,7 +114,10 @@ static void system_tray_plugin_handle_method_call(SystemTrayPlugin* self,
              strcmp(method, kSetContextMenu) == 0 ||
              strcmp(method, kPopupContextMenu) == 0 ||
              strcmp(method, kGetTitle) == 0 ||
-             strcmp(method, kDestroySystemTray) == 0) {
+             strcmp(method, kDestroySystemTray) == 0 ||
+             strcmp(method, kSetImageFrame) == 0 ||
+             strcmp(method, kRegisterTrayStates) == 0 ||
+             strcmp(method, kSetTrayState) == 0) {
     self->tray->handle_method_call(method_call);
   } else {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
@@ -76,14 +128,148 @@ static void system_tray_plugin_handle_method_call(SystemTrayPlugin* self,
   }
 }
 
+#ifdef SYSTEM_TRAY_TESTING
+static FlMethodResponse* activate_menu_item(SystemTrayPlugin* self,
+                                            FlValue* args) {
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        errors::kBadArgumentsError, "", nullptr));
+  }
+
+  FlValue* menu_id_value = fl_value_lookup_string(args, kMenuIdKey);
+  FlValue* menu_item_id_value = fl_value_lookup_string(args, kMenuItemIdKey);
+  if (!menu_id_value || fl_value_get_type(menu_id_value) != FL_VALUE_TYPE_INT ||
+      !menu_item_id_value ||
+      fl_value_get_type(menu_item_id_value) != FL_VALUE_TYPE_INT) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        errors::kBadArgumentsError, "", nullptr));
+  }
+
+  std::shared_ptr<Menu> menu =
+      self->menu_manager->get_menu(fl_value_get_int(menu_id_value));
+  g_autoptr(FlValue) result = fl_value_new_bool(
+      menu && menu->activate_menu_item(fl_value_get_int(menu_item_id_value)));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static void testing_method_call_cb(FlMethodChannel* channel,
+                                   FlMethodCall* method_call,
+                                   gpointer user_data) {
+  SystemTrayPlugin* self = SYSTEM_TRAY_PLUGIN(user_data);
+
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kGetIndicatorState) == 0) {
+    int64_t visible_uptime_us = headless_indicator_visible_uptime_us();
+    g_autoptr(FlValue) result = fl_value_new_map();
+    fl_value_set_string_take(result, kVisibleKey,
+                             fl_value_new_bool(visible_uptime_us != 0));
+    fl_value_set_string_take(result, kVisibleUptimeUsKey,
+                             fl_value_new_int(visible_uptime_us));
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else if (strcmp(method, kActivateMenuItem) == 0) {
+    response = activate_menu_item(self, fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+#endif
+
+static gboolean restore_snapshot_cb(gpointer user_data) {
+  SystemTrayPlugin* self = SYSTEM_TRAY_PLUGIN(user_data);
+
+  // Runs before Dart can call in, so the tray shows while the engine is
+  // still starting.
+  self->tray->restore_snapshot();
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean apply_tray_updates_cb(gpointer user_data) {
+  // Left queued until the plugin is registered, which drains them again.
+  if (!g_plugin || !g_plugin->tray) {
+    return G_SOURCE_REMOVE;
+  }
+
+  for (const TrayUpdate& update : g_tray_updates.take()) {
+    g_plugin->tray->apply_update(update);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void push_tray_update(TrayUpdate update) {
+  // Only the first update after a drain needs to wake up the main loop, the
+  // others are taken along with it.
+  if (g_tray_updates.push(std::move(update))) {
+    g_idle_add(apply_tray_updates_cb, &g_tray_updates);
+  }
+}
+
+void system_tray_set_icon(const gchar* icon_path) {
+  TrayUpdate update;
+  update.field = TrayUpdateField::kIcon;
+  update.text = icon_path ? icon_path : "";
+  push_tray_update(std::move(update));
+}
+
+void system_tray_set_label(const gchar* label) {
+  TrayUpdate update;
+  update.field = TrayUpdateField::kLabel;
+  update.text = label ? label : "";
+  push_tray_update(std::move(update));
+}
+
+void system_tray_set_menu_item_label(int64_t menu_item_id,
+                                     const gchar* label) {
+  TrayUpdate update;
+  update.field = TrayUpdateField::kMenuItemLabel;
+  update.menu_item_id = menu_item_id;
+  update.text = label ? label : "";
+  push_tray_update(std::move(update));
+}
+
+void system_tray_set_menu_item_enabled(int64_t menu_item_id,
+                                       gboolean enabled) {
+  TrayUpdate update;
+  update.field = TrayUpdateField::kMenuItemEnabled;
+  update.menu_item_id = menu_item_id;
+  update.flag = enabled;
+  push_tray_update(std::move(update));
+}
+
+void system_tray_set_menu_item_checked(int64_t menu_item_id,
+                                       gboolean checked) {
+  TrayUpdate update;
+  update.field = TrayUpdateField::kMenuItemChecked;
+  update.menu_item_id = menu_item_id;
+  update.flag = checked;
+  push_tray_update(std::move(update));
+}
+
 static void system_tray_plugin_dispose(GObject* object) {
   SystemTrayPlugin* self = SYSTEM_TRAY_PLUGIN(object);
 
+  // Updates from other threads and forwarded launches arriving after the
+  // engine shut down are queued again instead of reaching this plugin.
+  if (g_plugin == self) {
+    g_plugin = nullptr;
+    while (g_idle_remove_by_data(&g_tray_updates)) {
+    }
+  }
+
   g_clear_object(&self->registrar);
 
   g_clear_object(&self->channel_app_window);
   g_clear_object(&self->channel_menu_manager);
   g_clear_object(&self->channel_tray);
+#ifdef SYSTEM_TRAY_TESTING
+  g_clear_object(&self->channel_testing);
+#endif
 
   G_OBJECT_CLASS(system_tray_plugin_parent_class)->dispose(object);
 }
@@ -96,14 +282,108 @@ static void system_tray_plugin_init(SystemTrayPlugin* self) {
   g_plugin = self;
 }
 
+static void forward_action_cb(GSimpleAction* action,
+                              GVariant* parameter,
+                              gpointer user_data) {
+  std::vector<std::string> arguments;
+  g_autofree const gchar** strv = g_variant_get_strv(parameter, nullptr);
+  for (const gchar** iter = strv; iter && *iter; ++iter) {
+    arguments.emplace_back(*iter);
+  }
+
+  if (g_plugin && g_plugin->app_window) {
+    g_plugin->app_window->notify_activated(arguments);
+  } else {
+    g_pending_activations.push_back(std::move(arguments));
+  }
+}
+
+gboolean system_tray_plugin_forward_to_primary_instance(
+    GApplication* application,
+    gchar** arguments) {
+  g_autoptr(GError) error = nullptr;
+  if (!g_application_register(application, nullptr, &error)) {
+    g_warning("Failed to register: %s", error->message);
+    return FALSE;
+  }
+
+  if (!g_application_get_is_remote(application)) {
+    g_autoptr(GSimpleAction) action =
+        g_simple_action_new(kForwardActionName, G_VARIANT_TYPE_STRING_ARRAY);
+    g_signal_connect(action, "activate", G_CALLBACK(forward_action_cb),
+                     nullptr);
+    g_action_map_add_action(G_ACTION_MAP(application), G_ACTION(action));
+    return FALSE;
+  }
+
+  // Activating an action on a remote application is proxied over D-Bus, so
+  // this only costs one message to the first instance.
+  const gchar* const empty_arguments[] = {nullptr};
+  const gchar* const* forwarded_arguments = empty_arguments;
+  if (arguments) {
+    forwarded_arguments = arguments;
+  }
+  g_action_group_activate_action(G_ACTION_GROUP(application),
+                                 kForwardActionName,
+                                 g_variant_new_strv(forwarded_arguments, -1));
+
+  GDBusConnection* connection = g_application_get_dbus_connection(application);
+  if (connection) {
+    g_dbus_connection_flush_sync(connection, nullptr, nullptr);
+  }
+  return TRUE;
+}
+
+gboolean system_tray_plugin_has_start_hidden_argument(gchar** arguments) {
+  for (gchar** iter = arguments; iter && *iter; ++iter) {
+    if (strcmp(*iter, kStartHiddenArgument) == 0) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+void system_tray_plugin_start_hidden(FlView* view) {
+  // Realizing the view realizes the window as well, without mapping it.
+  // AppWindow finds the window hidden once Dart initializes it.
+  gtk_widget_realize(GTK_WIDGET(view));
+}
+
 static void method_call_cb(FlMethodChannel* channel,
                            FlMethodCall* method_call,
                            gpointer user_data) {
   SystemTrayPlugin* plugin = SYSTEM_TRAY_PLUGIN(user_data);
+
+  if (plugin->trace_writer) {
+    TraceChannel trace_channel = TraceChannel::kTray;
+    if (channel == plugin->channel_menu_manager) {
+      trace_channel = TraceChannel::kMenuManager;
+    } else if (channel == plugin->channel_app_window) {
+      trace_channel = TraceChannel::kAppWindow;
+    }
+    plugin->trace_writer->record(trace_channel,
+                                 fl_method_call_get_name(method_call),
+                                 fl_method_call_get_args(method_call));
+  }
+
   system_tray_plugin_handle_method_call(plugin, method_call);
 }
 
 void system_tray_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+#ifdef SYSTEM_TRAY_TESTING
+  bool headless = headless_indicator_requested();
+  if (headless) {
+    headless_indicator_install();
+  }
+#else
+  constexpr bool headless = false;
+#endif
+  if (!headless) {
+    // Resolve the indicator library while the engine starts up, so it is
+    // ready by the time Dart calls InitSystemTray.
+    indicator_api_preload();
+  }
+
   SystemTrayPlugin* plugin =
       SYSTEM_TRAY_PLUGIN(g_object_new(system_tray_plugin_get_type(), nullptr));
 
@@ -126,15 +406,22 @@ void system_tray_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
       fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
                             kChannelNameTray, FL_METHOD_CODEC(codec_tray));
 
-  plugin->app_window = std::make_unique<AppWindow>(plugin->registrar,
-                                                   plugin->channel_app_window);
-
   plugin->menu_manager =
       std::make_shared<MenuManager>(plugin->channel_menu_manager);
 
+  plugin->app_window = std::make_shared<AppWindow>(
+      plugin->registrar, plugin->channel_app_window);
+  plugin->menu_manager->set_app_window(plugin->app_window);
+
   plugin->tray =
       std::make_unique<Tray>(plugin->channel_tray, plugin->menu_manager);
 
+  plugin->trace_writer = TraceWriter::create_from_environment();
+
+  g_idle_add_full(G_PRIORITY_DEFAULT, restore_snapshot_cb, g_object_ref(plugin),
+                  g_object_unref);
+  g_idle_add(apply_tray_updates_cb, &g_tray_updates);
+
   fl_method_channel_set_method_call_handler(
       plugin->channel_app_window, method_call_cb, g_object_ref(plugin),
       g_object_unref);
@@ -147,5 +434,23 @@ void system_tray_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
       plugin->channel_tray, method_call_cb, g_object_ref(plugin),
       g_object_unref);
 
+#ifdef SYSTEM_TRAY_TESTING
+  if (headless) {
+    g_autoptr(FlStandardMethodCodec) codec_testing =
+        fl_standard_method_codec_new();
+    plugin->channel_testing = fl_method_channel_new(
+        fl_plugin_registrar_get_messenger(registrar), kChannelNameTesting,
+        FL_METHOD_CODEC(codec_testing));
+    fl_method_channel_set_method_call_handler(
+        plugin->channel_testing, testing_method_call_cb, g_object_ref(plugin),
+        g_object_unref);
+  }
+#endif
+
+  for (const auto& arguments : g_pending_activations) {
+    plugin->app_window->notify_activated(arguments);
+  }
+  g_pending_activations.clear();
+
   g_object_unref(plugin);
 }
\ No newline at end of file
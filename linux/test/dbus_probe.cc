@@ -0,0 +1,652 @@
+// Measures how long tray and menu updates take to reach a panel over D-Bus.
+//
+// Starts a private session bus with a stand-in StatusNotifierWatcher, lets
+// the real appindicator library register the plugin's indicator with it and
+// fetches the menu layout the way a panel would. Each operation is then run
+// through Tray and MenuManager as if called from Dart, and the signals the
+// indicator emits in response are timed and counted on the watcher's own
+// connection.
+//
+// Usage: system_tray_dbus_probe [--iterations=COUNT]
+
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../indicator_api.h"
+#include "../menu_manager.h"
+#include "../tray.h"
+#include "test_utils.h"
+
+namespace {
+
+// Returned when the environment can't run the probe, see SKIP_RETURN_CODE in
+// CMakeLists.txt.
+constexpr int kSkipReturnCode = 77;
+
+constexpr char kWatcherName[] = "org.kde.StatusNotifierWatcher";
+constexpr char kWatcherPath[] = "/StatusNotifierWatcher";
+constexpr char kWatcherInterface[] = "org.kde.StatusNotifierWatcher";
+constexpr char kItemInterface[] = "org.kde.StatusNotifierItem";
+constexpr char kItemDefaultPath[] = "/StatusNotifierItem";
+constexpr char kDbusMenuInterface[] = "com.canonical.dbusmenu";
+
+constexpr char kWatcherXml[] =
+    "<node>"
+    "  <interface name='org.kde.StatusNotifierWatcher'>"
+    "    <method name='RegisterStatusNotifierItem'>"
+    "      <arg type='s' direction='in'/>"
+    "    </method>"
+    "    <method name='RegisterStatusNotifierHost'>"
+    "      <arg type='s' direction='in'/>"
+    "    </method>"
+    "    <property name='RegisteredStatusNotifierItems' type='as'"
+    "              access='read'/>"
+    "    <property name='IsStatusNotifierHostRegistered' type='b'"
+    "              access='read'/>"
+    "    <property name='ProtocolVersion' type='i' access='read'/>"
+    "    <signal name='StatusNotifierItemRegistered'>"
+    "      <arg type='s'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+constexpr gint64 kRegistrationTimeoutUs = 5 * G_USEC_PER_SEC;
+constexpr gint64 kOperationTimeoutUs = 2 * G_USEC_PER_SEC;
+
+// Signals arriving within this long of the previous one are counted towards
+// the same operation.
+constexpr gint64 kSettleUs = 100 * 1000;
+
+constexpr int kMenuId = 1;
+constexpr int kMenuItemCount = 10;
+constexpr int kCheckboxItemId = kMenuItemCount;
+
+struct SignalRecord {
+  gint64 time = 0;
+  std::string member;
+  gsize bytes = 0;
+};
+
+struct OperationStats {
+  int64_t count = 0;
+  int64_t timeouts = 0;
+  gint64 total_latency_us = 0;
+  gint64 max_latency_us = 0;
+  int64_t signals = 0;
+  int64_t bytes = 0;
+  std::map<std::string, int64_t> members;
+};
+
+class Probe {
+ public:
+  Probe(int iterations, const std::string& temp_dir)
+      : iterations_(iterations), temp_dir_(temp_dir) {}
+  ~Probe() noexcept;
+
+  // Returns kSkipReturnCode if the probe can't run here.
+  int run();
+
+ private:
+  bool start_bus();
+  bool start_watcher();
+  bool register_indicator();
+  bool fetch_layout();
+  bool write_icons();
+
+  void run_operations();
+  void measure(const char* name, const std::function<void()>& action);
+  void print_stats();
+
+  void call(FlMethodResponse* response);
+  FlValue* menu_list(const char* prefix);
+  void create_context_menu(const char* prefix);
+  void pump();
+
+  static GDBusMessage* static_filter_fun(GDBusConnection* connection,
+                                         GDBusMessage* message,
+                                         gboolean incoming,
+                                         gpointer user_data);
+  void filter_fun(GDBusMessage* message);
+
+  static void static_method_call_fun(GDBusConnection* connection,
+                                     const gchar* sender,
+                                     const gchar* object_path,
+                                     const gchar* interface_name,
+                                     const gchar* method_name,
+                                     GVariant* parameters,
+                                     GDBusMethodInvocation* invocation,
+                                     gpointer user_data);
+  static GVariant* static_get_property_fun(GDBusConnection* connection,
+                                           const gchar* sender,
+                                           const gchar* object_path,
+                                           const gchar* interface_name,
+                                           const gchar* property_name,
+                                           GError** error,
+                                           gpointer user_data);
+
+  int iterations_;
+  std::string temp_dir_;
+  std::string icon_paths_[2];
+
+  GTestDBus* bus_ = nullptr;
+  GDBusConnection* connection_ = nullptr;
+  GDBusNodeInfo* watcher_info_ = nullptr;
+  guint watcher_id_ = 0;
+
+  std::shared_ptr<MenuManager> menu_manager_;
+  std::unique_ptr<Tray> tray_;
+
+  // Written on the GDBus worker thread by the filter.
+  std::mutex mutex_;
+  std::string item_name_;
+  std::string item_path_;
+  std::vector<SignalRecord> records_;
+
+  std::vector<std::string> operation_order_;
+  std::map<std::string, OperationStats> stats_;
+};
+
+Probe::~Probe() noexcept {
+  tray_.reset();
+  menu_manager_.reset();
+
+  if (connection_) {
+    if (watcher_id_) {
+      g_dbus_connection_unregister_object(connection_, watcher_id_);
+    }
+    g_dbus_connection_close_sync(connection_, nullptr, nullptr);
+    g_object_unref(connection_);
+    connection_ = nullptr;
+  }
+
+  if (watcher_info_) {
+    g_dbus_node_info_unref(watcher_info_);
+    watcher_info_ = nullptr;
+  }
+
+  if (bus_) {
+    g_test_dbus_down(bus_);
+    g_object_unref(bus_);
+    bus_ = nullptr;
+  }
+}
+
+int Probe::run() {
+  if (!start_bus()) {
+    return kSkipReturnCode;
+  }
+
+  if (!gtk_init_check(nullptr, nullptr)) {
+    fprintf(stderr, "No display available, skipping\n");
+    return kSkipReturnCode;
+  }
+
+  if (!indicator_api_get()) {
+    fprintf(stderr, "No appindicator library available, skipping\n");
+    return kSkipReturnCode;
+  }
+
+  if (!write_icons() || !start_watcher() || !register_indicator() ||
+      !fetch_layout()) {
+    return 1;
+  }
+
+  run_operations();
+  print_stats();
+
+  for (const auto& iter : stats_) {
+    if (iter.second.timeouts > 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+bool Probe::start_bus() {
+  g_autofree gchar* daemon = g_find_program_in_path("dbus-daemon");
+  if (!daemon) {
+    fprintf(stderr, "dbus-daemon not found, skipping\n");
+    return false;
+  }
+
+  // Sets DBUS_SESSION_BUS_ADDRESS, so the indicator registers on this bus.
+  bus_ = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(bus_);
+  return g_test_dbus_get_bus_address(bus_) != nullptr;
+}
+
+bool Probe::start_watcher() {
+  g_autoptr(GError) error = nullptr;
+
+  // A connection of its own, so signals are timed as the panel would see
+  // them, after a round trip through the bus.
+  connection_ = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(bus_),
+      static_cast<GDBusConnectionFlags>(
+          G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+          G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+      nullptr, nullptr, &error);
+  if (!connection_) {
+    fprintf(stderr, "Failed to connect to the bus: %s\n", error->message);
+    return false;
+  }
+
+  g_dbus_connection_add_filter(connection_, Probe::static_filter_fun, this,
+                               nullptr);
+
+  watcher_info_ = g_dbus_node_info_new_for_xml(kWatcherXml, &error);
+  if (!watcher_info_) {
+    fprintf(stderr, "Failed to parse the watcher: %s\n", error->message);
+    return false;
+  }
+
+  static const GDBusInterfaceVTable vtable = {
+      Probe::static_method_call_fun, Probe::static_get_property_fun, nullptr};
+  watcher_id_ = g_dbus_connection_register_object(
+      connection_, kWatcherPath,
+      g_dbus_node_info_lookup_interface(watcher_info_, kWatcherInterface),
+      &vtable, this, nullptr, &error);
+  if (!watcher_id_) {
+    fprintf(stderr, "Failed to export the watcher: %s\n", error->message);
+    return false;
+  }
+
+  // Flags are DBUS_NAME_FLAG_DO_NOT_QUEUE, and the reply is expected to be
+  // DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER.
+  g_autoptr(GVariant) reply = g_dbus_connection_call_sync(
+      connection_, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+      "org.freedesktop.DBus", "RequestName",
+      g_variant_new("(su)", kWatcherName, 0x4), G_VARIANT_TYPE("(u)"),
+      G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+  guint32 result = 0;
+  if (reply) {
+    g_variant_get(reply, "(u)", &result);
+  }
+  if (result != 1) {
+    fprintf(stderr, "Failed to own %s\n", kWatcherName);
+    return false;
+  }
+  return true;
+}
+
+bool Probe::register_indicator() {
+  menu_manager_ = std::make_shared<MenuManager>(nullptr);
+  tray_ = std::make_unique<Tray>(nullptr, menu_manager_);
+
+  g_autoptr(FlValue) init_args = fl_value_new_map();
+  fl_value_set_string_take(init_args, "tray_id",
+                           fl_value_new_string("system_tray_dbus_probe"));
+  fl_value_set_string_take(init_args, "title", fl_value_new_string("Probe"));
+  fl_value_set_string_take(init_args, "iconpath",
+                           fl_value_new_string(icon_paths_[0].c_str()));
+  call(tray_->handle_method(kInitSystemTray, init_args));
+
+  create_context_menu("Item");
+
+  gint64 deadline = g_get_monotonic_time() + kRegistrationTimeoutUs;
+  while (g_get_monotonic_time() < deadline) {
+    pump();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!item_name_.empty()) {
+      return true;
+    }
+  }
+
+  fprintf(stderr, "The indicator didn't register with the watcher\n");
+  return false;
+}
+
+// Reads the menu layout once, as a panel does before it listens for updates.
+bool Probe::fetch_layout() {
+  std::string item_name;
+  std::string item_path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    item_name = item_name_;
+    item_path = item_path_;
+  }
+
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GVariant) menu_reply = g_dbus_connection_call_sync(
+      connection_, item_name.c_str(), item_path.c_str(),
+      "org.freedesktop.DBus.Properties", "Get",
+      g_variant_new("(ss)", kItemInterface, "Menu"), G_VARIANT_TYPE("(v)"),
+      G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+  if (!menu_reply) {
+    fprintf(stderr, "Failed to get the menu path: %s\n", error->message);
+    return false;
+  }
+
+  g_autoptr(GVariant) menu_path = nullptr;
+  g_variant_get(menu_reply, "(v)", &menu_path);
+
+  g_autoptr(GVariant) layout = g_dbus_connection_call_sync(
+      connection_, item_name.c_str(), g_variant_get_string(menu_path, nullptr),
+      kDbusMenuInterface, "GetLayout",
+      g_variant_new("(ii@as)", 0, -1, g_variant_new_strv(nullptr, 0)), nullptr,
+      G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+  if (!layout) {
+    fprintf(stderr, "Failed to get the menu layout: %s\n", error->message);
+    return false;
+  }
+  return true;
+}
+
+bool Probe::write_icons() {
+  const guint32 colors[] = {0x3366ccff, 0xcc6633ff};
+  for (int i = 0; i < 2; ++i) {
+    std::string name = "icon" + std::to_string(i) + ".png";
+    icon_paths_[i] = write_test_image(temp_dir_.c_str(), name.c_str(),
+                                      colors[i]);
+    if (icon_paths_[i].empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Probe::run_operations() {
+  for (int i = 0; i < iterations_; ++i) {
+    std::string text = std::to_string(i);
+
+    measure("SetSystemTrayInfo(title)", [&]() {
+      g_autoptr(FlValue) args = fl_value_new_map();
+      fl_value_set_string_take(
+          args, "title", fl_value_new_string(("Title " + text).c_str()));
+      call(tray_->handle_method(kSetSystemTrayInfo, args));
+    });
+
+    measure("SetSystemTrayInfo(icon)", [&]() {
+      g_autoptr(FlValue) args = fl_value_new_map();
+      fl_value_set_string_take(
+          args, "iconpath",
+          fl_value_new_string(icon_paths_[(i + 1) % 2].c_str()));
+      call(tray_->handle_method(kSetSystemTrayInfo, args));
+    });
+
+    measure("SetLabel", [&]() {
+      g_autoptr(FlValue) args = fl_value_new_map();
+      fl_value_set_string_take(args, "menu_id", fl_value_new_int(kMenuId));
+      fl_value_set_string_take(args, "menu_item_id", fl_value_new_int(1));
+      fl_value_set_string_take(args, "label",
+                               fl_value_new_string(("Label " + text).c_str()));
+      call(menu_manager_->handle_method(kSetLabel, args));
+    });
+
+    measure("SetEnable", [&]() {
+      g_autoptr(FlValue) args = fl_value_new_map();
+      fl_value_set_string_take(args, "menu_id", fl_value_new_int(kMenuId));
+      fl_value_set_string_take(args, "menu_item_id", fl_value_new_int(2));
+      fl_value_set_string_take(args, "enabled", fl_value_new_bool(i % 2 == 1));
+      call(menu_manager_->handle_method(kSetEnable, args));
+    });
+
+    measure("SetCheck", [&]() {
+      g_autoptr(FlValue) args = fl_value_new_map();
+      fl_value_set_string_take(args, "menu_id", fl_value_new_int(kMenuId));
+      fl_value_set_string_take(args, "menu_item_id",
+                               fl_value_new_int(kCheckboxItemId));
+      fl_value_set_string_take(args, "checked", fl_value_new_bool(i % 2 == 0));
+      call(menu_manager_->handle_method(kSetCheck, args));
+    });
+
+    measure("CreateContextMenu", [&]() {
+      create_context_menu(("Rebuilt " + text).c_str());
+    });
+  }
+}
+
+void Probe::measure(const char* name, const std::function<void()>& action) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    records_.clear();
+  }
+
+  gint64 start_time = g_get_monotonic_time();
+  action();
+
+  std::vector<SignalRecord> records;
+  for (;;) {
+    pump();
+
+    gint64 now = g_get_monotonic_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!records_.empty() && now - records_.back().time > kSettleUs) {
+      records.swap(records_);
+      break;
+    }
+    if (records_.empty() && now - start_time > kOperationTimeoutUs) {
+      break;
+    }
+  }
+
+  if (stats_.find(name) == stats_.end()) {
+    operation_order_.push_back(name);
+  }
+  OperationStats& stats = stats_[name];
+  ++stats.count;
+
+  if (records.empty()) {
+    ++stats.timeouts;
+    return;
+  }
+
+  gint64 latency_us = records.front().time - start_time;
+  stats.total_latency_us += latency_us;
+  stats.max_latency_us = MAX(stats.max_latency_us, latency_us);
+  for (const auto& record : records) {
+    ++stats.signals;
+    stats.bytes += record.bytes;
+    ++stats.members[record.member];
+  }
+}
+
+void Probe::print_stats() {
+  printf("%-26s %6s %8s %12s %12s %9s %9s  %s\n", "operation", "runs",
+         "timeouts", "latency_us", "max_us", "signals", "bytes", "members");
+  for (const auto& name : operation_order_) {
+    const OperationStats& stats = stats_[name];
+    int64_t received = stats.count - stats.timeouts;
+    int64_t divisor = MAX(received, 1);
+
+    std::string members;
+    for (const auto& iter : stats.members) {
+      if (!members.empty()) {
+        members += ",";
+      }
+      members += iter.first;
+    }
+
+    printf("%-26s %6" G_GINT64_FORMAT " %8" G_GINT64_FORMAT
+           " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %9.1f %9.1f  %s\n",
+           name.c_str(), stats.count, stats.timeouts,
+           stats.total_latency_us / divisor, stats.max_latency_us,
+           stats.signals / static_cast<double>(divisor),
+           stats.bytes / static_cast<double>(divisor), members.c_str());
+  }
+}
+
+void Probe::call(FlMethodResponse* response) {
+  if (response) {
+    g_object_unref(response);
+  }
+}
+
+FlValue* Probe::menu_list(const char* prefix) {
+  FlValue* list = fl_value_new_list();
+  for (int id = 1; id <= kMenuItemCount; ++id) {
+    FlValue* item = fl_value_new_map();
+    bool checkbox = id == kCheckboxItemId;
+    std::string label = std::string(prefix) + " " + std::to_string(id);
+    fl_value_set_string_take(
+        item, "type", fl_value_new_string(checkbox ? "checkbox" : "label"));
+    fl_value_set_string_take(item, "id", fl_value_new_int(id));
+    fl_value_set_string_take(item, "label", fl_value_new_string(label.c_str()));
+    fl_value_set_string_take(item, "enabled", fl_value_new_bool(TRUE));
+    if (checkbox) {
+      fl_value_set_string_take(item, "checked", fl_value_new_bool(FALSE));
+    }
+    fl_value_append_take(list, item);
+  }
+  return list;
+}
+
+void Probe::create_context_menu(const char* prefix) {
+  g_autoptr(FlValue) menu_args = fl_value_new_map();
+  fl_value_set_string_take(menu_args, "menu_id", fl_value_new_int(kMenuId));
+  fl_value_set_string_take(menu_args, "menu_list", menu_list(prefix));
+  call(menu_manager_->handle_method(kCreateContextMenu, menu_args));
+
+  g_autoptr(FlValue) context_menu_args = fl_value_new_int(kMenuId);
+  call(tray_->handle_method(kSetContextMenu, context_menu_args));
+}
+
+void Probe::pump() {
+  bool dispatched = false;
+  while (g_main_context_iteration(nullptr, FALSE)) {
+    dispatched = true;
+  }
+  if (!dispatched) {
+    g_usleep(500);
+  }
+}
+
+// static
+GDBusMessage* Probe::static_filter_fun(GDBusConnection* connection,
+                                       GDBusMessage* message,
+                                       gboolean incoming,
+                                       gpointer user_data) {
+  if (incoming &&
+      g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_SIGNAL) {
+    reinterpret_cast<Probe*>(user_data)->filter_fun(message);
+  }
+  return message;
+}
+
+// Runs on the GDBus worker thread, as soon as a signal is read off the bus.
+void Probe::filter_fun(GDBusMessage* message) {
+  gint64 now = g_get_monotonic_time();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const gchar* sender = g_dbus_message_get_sender(message);
+  if (item_name_.empty() || g_strcmp0(sender, item_name_.c_str()) != 0) {
+    return;
+  }
+
+  gsize bytes = 0;
+  g_autofree guchar* blob = g_dbus_message_to_blob(
+      message, &bytes, G_DBUS_CAPABILITY_FLAGS_NONE, nullptr);
+
+  SignalRecord record;
+  record.time = now;
+  record.member = g_dbus_message_get_member(message);
+  record.bytes = bytes;
+  records_.push_back(std::move(record));
+}
+
+// static
+void Probe::static_method_call_fun(GDBusConnection* connection,
+                                   const gchar* sender,
+                                   const gchar* object_path,
+                                   const gchar* interface_name,
+                                   const gchar* method_name,
+                                   GVariant* parameters,
+                                   GDBusMethodInvocation* invocation,
+                                   gpointer user_data) {
+  Probe* self = reinterpret_cast<Probe*>(user_data);
+
+  if (strcmp(method_name, "RegisterStatusNotifierItem") == 0) {
+    const gchar* service = nullptr;
+    g_variant_get(parameters, "(&s)", &service);
+
+    // Items pass either their object path or a bus name.
+    std::string item_name = sender;
+    std::string item_path = kItemDefaultPath;
+    if (service[0] == '/') {
+      item_path = service;
+    } else {
+      item_name = service;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(self->mutex_);
+      self->item_name_ = item_name;
+      self->item_path_ = item_path;
+    }
+
+    std::string registered = item_name + item_path;
+    g_dbus_connection_emit_signal(
+        connection, nullptr, kWatcherPath, kWatcherInterface,
+        "StatusNotifierItemRegistered",
+        g_variant_new("(s)", registered.c_str()), nullptr);
+  }
+
+  g_dbus_method_invocation_return_value(invocation, nullptr);
+}
+
+// static
+GVariant* Probe::static_get_property_fun(GDBusConnection* connection,
+                                         const gchar* sender,
+                                         const gchar* object_path,
+                                         const gchar* interface_name,
+                                         const gchar* property_name,
+                                         GError** error,
+                                         gpointer user_data) {
+  Probe* self = reinterpret_cast<Probe*>(user_data);
+
+  if (strcmp(property_name, "RegisteredStatusNotifierItems") == 0) {
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    std::string registered = self->item_name_ + self->item_path_;
+    const gchar* items[] = {registered.c_str(), nullptr};
+    return g_variant_new_strv(items, self->item_name_.empty() ? 0 : 1);
+  } else if (strcmp(property_name, "IsStatusNotifierHostRegistered") == 0) {
+    return g_variant_new_boolean(TRUE);
+  } else if (strcmp(property_name, "ProtocolVersion") == 0) {
+    return g_variant_new_int32(0);
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 20;
+  for (int i = 1; i < argc; ++i) {
+    if (g_str_has_prefix(argv[i], "--iterations=")) {
+      iterations = atoi(argv[i] + strlen("--iterations="));
+    } else {
+      fprintf(stderr, "Usage: %s [--iterations=COUNT]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  g_autofree gchar* temp_dir =
+      g_dir_make_tmp("system_tray_dbus_probe_XXXXXX", nullptr);
+  if (!temp_dir) {
+    fprintf(stderr, "Failed to create a temporary directory\n");
+    return 1;
+  }
+  // Keep rasterized icons out of the user's cache.
+  g_autofree gchar* cache_dir = g_build_filename(temp_dir, "cache", nullptr);
+  setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+  int result = 0;
+  {
+    Probe probe(MAX(iterations, 1), temp_dir);
+    result = probe.run();
+  }
+
+  remove_recursively(temp_dir);
+  return result;
+}
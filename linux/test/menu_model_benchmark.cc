@@ -0,0 +1,145 @@
+// Benchmarks the menu model shared by the Linux and Windows plugins.
+//
+// For menus of 10 to 10000 items, times parsing a menu_list as Dart sends it,
+// looking up every item by id, updating every label, and diffing against a
+// rebuilt menu with one changed item. Doesn't need a display, the widgets
+// aren't built.
+//
+// Usage: system_tray_menu_model_benchmark [--iterations=COUNT]
+
+#include <flutter_linux/flutter_linux.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../fl_menu_model.h"
+
+namespace {
+
+constexpr int kDefaultIterations = 200;
+constexpr int kMenuSizes[] = {10, 100, 1000, 10000};
+
+// Every tenth item is a submenu of up to five labels, the rest alternate
+// between labels and checkboxes.
+FlValue* menu_list(int size, const char* prefix) {
+  FlValue* list = fl_value_new_list();
+  FlValue* submenu = nullptr;
+  for (int id = 1; id <= size; ++id) {
+    std::string label = std::string(prefix) + " " + std::to_string(id);
+    bool is_submenu = id % 10 == 0 && id + 5 <= size;
+
+    FlValue* item = fl_value_new_map();
+    fl_value_set_string_take(
+        item, "type",
+        fl_value_new_string(is_submenu ? "submenu"
+                            : id % 2   ? "label"
+                                       : "checkbox"));
+    fl_value_set_string_take(item, "id", fl_value_new_int(id));
+    fl_value_set_string_take(item, "label", fl_value_new_string(label.c_str()));
+    fl_value_set_string_take(item, "enabled", fl_value_new_bool(TRUE));
+
+    if (is_submenu) {
+      submenu = fl_value_new_list();
+      fl_value_set_string_take(item, "submenu", submenu);
+      fl_value_append_take(list, item);
+    } else if (submenu && fl_value_get_length(submenu) < 5) {
+      fl_value_append_take(submenu, item);
+    } else {
+      submenu = nullptr;
+      fl_value_append_take(list, item);
+    }
+  }
+  return list;
+}
+
+// Returns the average time of |action| in microseconds.
+double measure(int iterations, const std::function<void()>& action) {
+  gint64 start_time = g_get_monotonic_time();
+  for (int i = 0; i < iterations; ++i) {
+    action();
+  }
+  return static_cast<double>(g_get_monotonic_time() - start_time) / iterations;
+}
+
+void run(int size, int iterations) {
+  g_autoptr(FlValue) list = menu_list(size, "Item");
+  g_autoptr(FlValue) rebuilt_list = menu_list(size, "Item");
+  FlValue* last = fl_value_get_list_value(
+      rebuilt_list, fl_value_get_length(rebuilt_list) - 1);
+  fl_value_set_string_take(last, "label", fl_value_new_string("Changed"));
+
+  MenuModel model;
+  double parse_us = measure(iterations, [&]() {
+    if (!fl_menu_model_parse(list, &model)) {
+      fprintf(stderr, "Failed to parse a menu of %d items\n", size);
+      exit(1);
+    }
+  });
+
+  uint32_t found = 0;
+  double find_us = measure(iterations, [&]() {
+    for (int id = 1; id <= size; ++id) {
+      found += model.find(id) != kNoMenuItem;
+    }
+  });
+
+  double set_label_us = measure(iterations, [&]() {
+    for (int id = 1; id <= size; ++id) {
+      model.set_label(id, "Updated label");
+    }
+  });
+
+  MenuModel rebuilt;
+  fl_menu_model_parse(list, &model);
+  fl_menu_model_parse(rebuilt_list, &rebuilt);
+  std::vector<MenuModelChange> changes;
+  double diff_us = measure(iterations, [&]() {
+    if (!MenuModel::diff(model, rebuilt, &changes) || changes.size() != 1) {
+      fprintf(stderr, "Unexpected diff of a menu of %d items\n", size);
+      exit(1);
+    }
+  });
+
+  double to_value_us = measure(iterations, [&]() {
+    g_autoptr(FlValue) value = fl_menu_model_to_value(model);
+  });
+
+  printf("%6d %12.1f %12.1f %14.1f %12.1f %14.1f %12zu\n", size, parse_us,
+         find_us, set_label_us, diff_us, to_value_us, model.string_bytes());
+  if (found != static_cast<uint32_t>(size) * iterations) {
+    fprintf(stderr, "Lost items in a menu of %d items\n", size);
+    exit(1);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = kDefaultIterations;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (g_str_has_prefix(arg, "--iterations=")) {
+      iterations = atoi(arg + strlen("--iterations="));
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    }
+  }
+
+  if (iterations <= 0) {
+    fprintf(stderr, "--iterations must be positive\n");
+    return 1;
+  }
+
+  printf("%6s %12s %12s %14s %12s %14s %12s\n", "items", "parse_us",
+         "find_all_us", "set_labels_us", "diff_us", "to_value_us",
+         "string_bytes");
+  for (int size : kMenuSizes) {
+    run(size, iterations);
+  }
+  return 0;
+}
@@ -0,0 +1,303 @@
+// Unit tests for the menu model shared by the Linux and Windows plugins, and
+// for its FlValue adapter.
+//
+// Usage: system_tray_menu_model_test
+
+#include <flutter_linux/flutter_linux.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "../fl_menu_model.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                             \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__,     \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (false)
+
+MenuItemFields item(MenuItemType type, int64_t id, const char* label) {
+  MenuItemFields fields;
+  fields.type = type;
+  fields.id = id;
+  fields.label = label;
+  return fields;
+}
+
+// Label 1, Checkbox 2, Submenu 3 { Label 4, Separator, Label 5 }, Label 6
+void build_sample(MenuModel* model, const char* first_label = "One") {
+  model->clear();
+  model->append_item(item(MenuItemType::kLabel, 1, first_label));
+  MenuItemFields checkbox = item(MenuItemType::kCheckbox, 2, "Two");
+  checkbox.checked = true;
+  model->append_item(checkbox);
+  uint32_t submenu =
+      model->append_item(item(MenuItemType::kSubMenu, 3, "Sub"));
+  model->append_item(item(MenuItemType::kLabel, 4, "Four"));
+  model->append_item(item(MenuItemType::kSeparator, 99, nullptr));
+  model->append_item(item(MenuItemType::kLabel, 5, "Five"));
+  model->end_submenu(submenu);
+  model->append_item(item(MenuItemType::kLabel, 6, "Six"));
+}
+
+void test_build_and_find() {
+  MenuModel model;
+  build_sample(&model);
+
+  EXPECT(model.size() == 7);
+  EXPECT(model.end(0) == 1);
+  EXPECT(model.end(2) == 6);
+  EXPECT(model.end(6) == 7);
+  EXPECT(model.type(4) == MenuItemType::kSeparator);
+  // Separators have no id, so they can't be found or updated.
+  EXPECT(model.id(4) == -1);
+  EXPECT(model.find(99) == kNoMenuItem);
+  EXPECT(model.find(5) == 5);
+  EXPECT(strcmp(model.label(5), "Five") == 0);
+  EXPECT(strcmp(model.image(5), "") == 0);
+  EXPECT(model.checked(1));
+  EXPECT(model.enabled(1));
+
+  // Top-level siblings, skipping the submenu's children.
+  std::vector<int64_t> ids;
+  for (uint32_t i = 0; i < model.size(); i = model.end(i)) {
+    ids.push_back(model.id(i));
+  }
+  EXPECT((ids == std::vector<int64_t>{1, 2, 3, 6}));
+}
+
+void test_setters() {
+  MenuModel model;
+  build_sample(&model);
+
+  EXPECT(model.set_label(4, "Vier"));
+  EXPECT(strcmp(model.label(3), "Vier") == 0);
+  EXPECT(model.set_image(1, "icon.png"));
+  EXPECT(strcmp(model.image(0), "icon.png") == 0);
+  EXPECT(model.set_enabled(3, false));
+  EXPECT(!model.enabled(2));
+  EXPECT(model.set_checked(2, false));
+  EXPECT(!model.checked(1));
+
+  // Only checkboxes and radio items can be checked.
+  EXPECT(!model.set_checked(1, true));
+  EXPECT(!model.checked(0));
+  EXPECT(!model.set_label(42, "Missing"));
+
+  // Setting a label to itself must not read from a reallocated buffer.
+  for (int i = 0; i < 100; ++i) {
+    EXPECT(model.set_label(6, model.label(6)));
+  }
+  EXPECT(strcmp(model.label(6), "Six") == 0);
+}
+
+void test_toggle_and_radio_groups() {
+  // Radio 1, Radio 2, Label 3, Radio 4, Submenu 5 { Radio 6, Radio 7 }
+  MenuModel model;
+  model.append_item(item(MenuItemType::kRadio, 1, "A"));
+  MenuItemFields checked_radio = item(MenuItemType::kRadio, 2, "B");
+  checked_radio.checked = true;
+  model.append_item(checked_radio);
+  model.append_item(item(MenuItemType::kLabel, 3, "Label"));
+  model.append_item(item(MenuItemType::kRadio, 4, "C"));
+  uint32_t submenu =
+      model.append_item(item(MenuItemType::kSubMenu, 5, "Sub"));
+  model.append_item(item(MenuItemType::kRadio, 6, "D"));
+  model.append_item(item(MenuItemType::kRadio, 7, "E"));
+  model.end_submenu(submenu);
+
+  model.check_radio_groups();
+
+  // Groups without a checked item get their first one checked.
+  EXPECT(model.checked(1) && !model.checked(0));
+  EXPECT(model.checked(3));
+  EXPECT(model.checked(5) && !model.checked(6));
+
+  EXPECT(model.parent(0) == kNoMenuItem);
+  EXPECT(model.parent(6) == 4);
+  EXPECT((model.radio_group(0) == std::vector<uint32_t>{0, 1}));
+  EXPECT((model.radio_group(1) == std::vector<uint32_t>{0, 1}));
+  // Split from the first group by the label, and not joined with the
+  // submenu's radio items.
+  EXPECT((model.radio_group(3) == std::vector<uint32_t>{3}));
+  EXPECT((model.radio_group(6) == std::vector<uint32_t>{5, 6}));
+  EXPECT(model.radio_group(2).empty());
+
+  EXPECT(model.toggle(1));
+  EXPECT(model.checked(0) && !model.checked(1));
+  // Clicking the checked radio item keeps it checked.
+  EXPECT(model.toggle(1));
+  EXPECT(model.checked(0));
+  EXPECT(!model.set_checked(1, false));
+  EXPECT(model.checked(0));
+  EXPECT(model.set_checked(7, true));
+  EXPECT(model.checked(6) && !model.checked(5));
+  EXPECT(model.checked(0) && model.checked(3));
+  EXPECT(!model.toggle(3));
+
+  // Of several checked items the last one stays checked.
+  MenuModel several;
+  MenuItemFields radio = item(MenuItemType::kRadio, 1, "A");
+  radio.checked = true;
+  several.append_item(radio);
+  radio.id = 2;
+  several.append_item(radio);
+  several.check_radio_groups();
+  EXPECT(!several.checked(0) && several.checked(1));
+
+  MenuModel checkboxes;
+  checkboxes.append_item(item(MenuItemType::kCheckbox, 1, "Check"));
+  EXPECT(checkboxes.toggle(1));
+  EXPECT(checkboxes.checked(0));
+  EXPECT(checkboxes.toggle(1));
+  EXPECT(!checkboxes.checked(0));
+}
+
+void test_compaction() {
+  MenuModel model;
+  build_sample(&model);
+  size_t initial_bytes = model.string_bytes();
+
+  for (int i = 0; i < 10000; ++i) {
+    std::string label = "Label " + std::to_string(i);
+    EXPECT(model.set_label(1, label.c_str()));
+  }
+
+  EXPECT(strcmp(model.label(0), "Label 9999") == 0);
+  EXPECT(strcmp(model.label(5), "Five") == 0);
+  EXPECT(model.string_bytes() < initial_bytes * 4);
+}
+
+void test_diff() {
+  MenuModel from;
+  MenuModel to;
+  std::vector<MenuModelChange> changes;
+
+  build_sample(&from);
+  build_sample(&to);
+  EXPECT(MenuModel::diff(from, to, &changes));
+  EXPECT(changes.empty());
+
+  build_sample(&to, "Uno");
+  to.set_enabled(5, false);
+  to.set_checked(2, false);
+  EXPECT(MenuModel::diff(from, to, &changes));
+  EXPECT(changes.size() == 3);
+  if (changes.size() == 3) {
+    EXPECT(changes[0].index == 0);
+    EXPECT(changes[0].fields == kMenuItemLabelChanged);
+    EXPECT(changes[1].index == 1);
+    EXPECT(changes[1].fields == kMenuItemCheckedChanged);
+    EXPECT(changes[2].index == 5);
+    EXPECT(changes[2].fields == kMenuItemEnabledChanged);
+  }
+
+  // Moving an item out of the submenu changes the structure.
+  to.clear();
+  to.append_item(item(MenuItemType::kLabel, 1, "One"));
+  to.append_item(item(MenuItemType::kCheckbox, 2, "Two"));
+  uint32_t submenu = to.append_item(item(MenuItemType::kSubMenu, 3, "Sub"));
+  to.append_item(item(MenuItemType::kLabel, 4, "Four"));
+  to.append_item(item(MenuItemType::kSeparator, -1, nullptr));
+  to.end_submenu(submenu);
+  to.append_item(item(MenuItemType::kLabel, 5, "Five"));
+  to.append_item(item(MenuItemType::kLabel, 6, "Six"));
+  EXPECT(!MenuModel::diff(from, to, &changes));
+  EXPECT(changes.empty());
+}
+
+FlValue* value_item(const char* type, int64_t id, const char* label) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "type", fl_value_new_string(type));
+  fl_value_set_string_take(value, "id", fl_value_new_int(id));
+  fl_value_set_string_take(value, "label", fl_value_new_string(label));
+  fl_value_set_string_take(value, "enabled", fl_value_new_bool(TRUE));
+  return value;
+}
+
+void test_fl_value_round_trip() {
+  g_autoptr(FlValue) list = fl_value_new_list();
+  FlValue* checkbox = value_item("checkbox", 1, "Check");
+  fl_value_set_string_take(checkbox, "checked", fl_value_new_bool(TRUE));
+  fl_value_append_take(list, checkbox);
+  FlValue* submenu = value_item("submenu", 2, "Sub");
+  FlValue* children = fl_value_new_list();
+  FlValue* child = value_item("label", 3, "Show");
+  fl_value_set_string_take(child, "image", fl_value_new_string("show.png"));
+  fl_value_set_string_take(child, "native_action",
+                           fl_value_new_string("show_app_window"));
+  fl_value_append_take(children, child);
+  fl_value_set_string_take(submenu, "submenu", children);
+  fl_value_append_take(list, submenu);
+  FlValue* radio = value_item("radio", 4, "Radio");
+  fl_value_set_string_take(radio, "checked", fl_value_new_bool(TRUE));
+  fl_value_append_take(list, radio);
+  FlValue* separator = fl_value_new_map();
+  fl_value_set_string_take(separator, "type", fl_value_new_string("separator"));
+  fl_value_append_take(list, separator);
+
+  MenuModel model;
+  EXPECT(fl_menu_model_parse(list, &model));
+  EXPECT(model.size() == 5);
+  EXPECT(model.type(3) == MenuItemType::kRadio && model.checked(3));
+  EXPECT(model.end(1) == 3);
+  EXPECT(strcmp(model.native_action(2), "show_app_window") == 0);
+
+  g_autoptr(FlValue) value = fl_menu_model_to_value(model);
+  EXPECT(fl_value_equal(value, list));
+
+  MenuModel reparsed;
+  std::vector<MenuModelChange> changes;
+  EXPECT(fl_menu_model_parse(value, &reparsed));
+  EXPECT(MenuModel::diff(model, reparsed, &changes));
+  EXPECT(changes.empty());
+}
+
+void test_fl_value_malformed() {
+  MenuModel model;
+  build_sample(&model);
+
+  // An item without a type.
+  g_autoptr(FlValue) list = fl_value_new_list();
+  fl_value_append_take(list, value_item("label", 1, "One"));
+  FlValue* untyped = fl_value_new_map();
+  fl_value_set_string_take(untyped, "id", fl_value_new_int(2));
+  fl_value_append_take(list, untyped);
+  EXPECT(!fl_menu_model_parse(list, &model));
+  EXPECT(model.size() == 0);
+
+  // A submenu without children.
+  g_autoptr(FlValue) submenu_list = fl_value_new_list();
+  fl_value_append_take(submenu_list, value_item("submenu", 1, "Sub"));
+  EXPECT(!fl_menu_model_parse(submenu_list, &model));
+
+  // Unknown types are shown as labels.
+  g_autoptr(FlValue) unknown_list = fl_value_new_list();
+  fl_value_append_take(unknown_list, value_item("switch", 1, "Switch"));
+  EXPECT(fl_menu_model_parse(unknown_list, &model));
+  EXPECT(model.size() == 1 && model.type(0) == MenuItemType::kLabel);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_build_and_find();
+  test_setters();
+  test_toggle_and_radio_groups();
+  test_compaction();
+  test_diff();
+  test_fl_value_round_trip();
+  test_fl_value_malformed();
+
+  printf("%s\n", g_failures == 0 ? "PASSED" : "FAILED");
+  return g_failures == 0 ? 0 : 1;
+}
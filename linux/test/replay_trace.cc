@@ -0,0 +1,238 @@
+// Replays a method call trace recorded with SYSTEM_TRAY_TRACE against a
+// headless indicator, and reports how long each method took to handle.
+//
+// Usage: system_tray_replay [--realtime] [--repeat=COUNT] TRACE
+//
+// By default calls are replayed back to back. With --realtime they are
+// spaced as recorded, pumping the GTK main loop in between, so timers and
+// idle work scheduled by the plugin run as they would in the application.
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "../app_window.h"
+#include "../headless_indicator.h"
+#include "../menu_manager.h"
+#include "../trace.h"
+#include "../tray.h"
+
+namespace {
+
+struct Options {
+  bool realtime = false;
+  int repeat = 1;
+  const char* trace_path = nullptr;
+};
+
+struct MethodStats {
+  int64_t count = 0;
+  int64_t errors = 0;
+  gint64 total_us = 0;
+  gint64 max_us = 0;
+};
+
+// Plays the part of the Flutter view: Dart's InitAppWindow picks up this
+// window instead of the engine's.
+class ReplayAppWindow : public AppWindow {
+ public:
+  ReplayAppWindow() noexcept
+      : AppWindow(nullptr, nullptr),
+        replay_window_(GTK_WINDOW(gtk_window_new(GTK_WINDOW_TOPLEVEL))) {
+    gtk_window_set_default_size(replay_window_, 320, 240);
+  }
+
+  ~ReplayAppWindow() noexcept {
+    gtk_widget_destroy(GTK_WIDGET(replay_window_));
+  }
+
+  FlMethodResponse* replay(const gchar* method, FlValue* args) {
+    if (strcmp(method, kInitAppWindow) == 0) {
+      g_autoptr(FlValue) result =
+          fl_value_new_bool(init_app_window(replay_window_));
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+    return handle_method(method, args);
+  }
+
+ protected:
+  GtkWindow* replay_window_ = nullptr;
+};
+
+class Replay {
+ public:
+  Replay(const Options& options) : options_(options) {}
+
+  bool run();
+
+ private:
+  bool replay_trace();
+  void wait_until(gint64 time);
+  void pump();
+  void print_stats(gint64 elapsed_us);
+
+  const Options& options_;
+
+  std::shared_ptr<MenuManager> menu_manager_;
+  std::unique_ptr<ReplayAppWindow> app_window_;
+  std::unique_ptr<Tray> tray_;
+
+  std::map<std::string, MethodStats> stats_;
+};
+
+bool Replay::run() {
+  menu_manager_ = std::make_shared<MenuManager>(nullptr);
+  app_window_ = std::make_unique<ReplayAppWindow>();
+  tray_ = std::make_unique<Tray>(nullptr, menu_manager_);
+
+  gint64 start_time = g_get_monotonic_time();
+
+  bool ok = true;
+  for (int i = 0; i < options_.repeat && ok; ++i) {
+    ok = replay_trace();
+  }
+
+  gint64 elapsed_us = g_get_monotonic_time() - start_time;
+  if (ok) {
+    print_stats(elapsed_us);
+  }
+
+  tray_.reset();
+  app_window_.reset();
+  menu_manager_.reset();
+  return ok;
+}
+
+bool Replay::replay_trace() {
+  TraceReader reader;
+  if (!reader.open(options_.trace_path)) {
+    fprintf(stderr, "Failed to open trace %s\n", options_.trace_path);
+    return false;
+  }
+
+  gint64 start_time = g_get_monotonic_time();
+  int64_t last_time_us = 0;
+
+  TraceRecord record;
+  while (reader.next(&record)) {
+    // Each run of the application appends to the trace with times starting
+    // over, so the next run is paced from when its first call is replayed.
+    if (record.time_us < last_time_us) {
+      start_time = g_get_monotonic_time() - record.time_us;
+    }
+    last_time_us = record.time_us;
+
+    if (options_.realtime) {
+      wait_until(start_time + record.time_us);
+    }
+
+    const gchar* method = record.method.c_str();
+
+    gint64 call_start = g_get_monotonic_time();
+    g_autoptr(FlMethodResponse) response = nullptr;
+    switch (record.channel) {
+      case TraceChannel::kTray:
+        response = tray_->handle_method(method, record.args);
+        break;
+      case TraceChannel::kMenuManager:
+        response = menu_manager_->handle_method(method, record.args);
+        break;
+      case TraceChannel::kAppWindow:
+        response = app_window_->replay(method, record.args);
+        break;
+    }
+    gint64 call_us = g_get_monotonic_time() - call_start;
+
+    MethodStats& stats = stats_[method];
+    ++stats.count;
+    stats.total_us += call_us;
+    stats.max_us = MAX(stats.max_us, call_us);
+    if (!FL_IS_METHOD_SUCCESS_RESPONSE(response)) {
+      ++stats.errors;
+    }
+
+    if (!options_.realtime) {
+      pump();
+    }
+  }
+
+  pump();
+  return true;
+}
+
+void Replay::wait_until(gint64 time) {
+  for (;;) {
+    pump();
+
+    gint64 remaining = time - g_get_monotonic_time();
+    if (remaining <= 0) {
+      break;
+    }
+    g_usleep(MIN(remaining, 1000));
+  }
+}
+
+void Replay::pump() {
+  while (gtk_events_pending()) {
+    gtk_main_iteration();
+  }
+}
+
+void Replay::print_stats(gint64 elapsed_us) {
+  printf("%-24s %8s %8s %12s %12s\n", "method", "calls", "errors",
+         "average_us", "max_us");
+  for (const auto& iter : stats_) {
+    const MethodStats& stats = iter.second;
+    printf("%-24s %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT
+           " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT "\n",
+           iter.first.c_str(), stats.count, stats.errors,
+           stats.total_us / stats.count, stats.max_us);
+  }
+  printf("total: %.3f s\n", elapsed_us / static_cast<double>(G_USEC_PER_SEC));
+}
+
+bool parse_options(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--realtime") == 0) {
+      options->realtime = true;
+    } else if (g_str_has_prefix(arg, "--repeat=")) {
+      options->repeat = atoi(arg + strlen("--repeat="));
+    } else if (g_str_has_prefix(arg, "--")) {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return false;
+    } else {
+      options->trace_path = arg;
+    }
+  }
+
+  if (!options->trace_path || options->repeat < 1) {
+    fprintf(stderr, "Usage: %s [--realtime] [--repeat=COUNT] TRACE\n",
+            argv[0]);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!gtk_init_check(&argc, &argv)) {
+    fprintf(stderr, "No display available, run under Xvfb\n");
+    return 1;
+  }
+
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    return 1;
+  }
+
+  headless_indicator_install();
+
+  return Replay(options).run() ? 0 : 1;
+}
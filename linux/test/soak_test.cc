@@ -0,0 +1,417 @@
+// Soak test for the native tray and menu code.
+//
+// Repeatedly builds random menu trees, updates their items and swaps them into
+// a headless indicator for a fixed amount of time, then compares resident
+// memory, open file descriptors and live GTK/GdkPixbuf instances against a
+// baseline taken after a warm-up. Exits non-zero when any of them grew past
+// its threshold, so leaks in the menu lifecycle show up in CI.
+//
+// Usage: system_tray_soak [--duration=SECONDS] [--rss-growth-kb=KB]
+//                         [--object-growth=COUNT] [--fd-growth=COUNT]
+//                         [--seed=SEED]
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../headless_indicator.h"
+#include "../menu.h"
+#include "../menu_manager.h"
+#include "../tray.h"
+#include "../utils.h"
+#include "test_utils.h"
+
+namespace {
+
+// Returned when there is no display to run against, see SKIP_RETURN_CODE in
+// CMakeLists.txt.
+constexpr int kSkipReturnCode = 77;
+
+constexpr int kWarmupIterations = 50;
+constexpr int kMaxMenuItems = 12;
+constexpr int kMaxSubMenuDepth = 2;
+
+// Instance types sampled for growth. Counting needs GOBJECT_DEBUG to contain
+// "instance-count" before GLib initializes.
+constexpr const char* kTrackedTypes[] = {
+    "GtkMenu",      "GtkMenuItem", "GtkCheckMenuItem", "GtkSeparatorMenuItem",
+    "GtkImage",     "GtkLabel",    "GtkBox",           "GtkWindow",
+    "GdkPixbuf",
+};
+
+struct Options {
+  double duration = 60;
+  int64_t rss_growth_kb = 2048;
+  int64_t object_growth = 0;
+  int64_t fd_growth = 0;
+  unsigned int seed = 0;
+};
+
+struct Sample {
+  int64_t rss = 0;
+  int64_t fds = 0;
+  std::vector<int64_t> objects;
+};
+
+// Exposes the FlValue entry points the method channels would call.
+class SoakMenuManager : public MenuManager {
+ public:
+  SoakMenuManager() noexcept : MenuManager(nullptr) {}
+
+  using MenuManager::create_context_menu;
+  using MenuManager::set_check;
+  using MenuManager::set_enable;
+  using MenuManager::set_image;
+  using MenuManager::set_label;
+};
+
+class SoakTray : public Tray {
+ public:
+  SoakTray(std::weak_ptr<MenuManager> menu_manager) noexcept
+      : Tray(nullptr, menu_manager) {}
+
+  using Tray::init_tray;
+  using Tray::set_context_menu;
+  using Tray::set_tray_info;
+};
+
+class Soak {
+ public:
+  Soak(const Options& options, const std::string& image_path)
+      : options_(options), image_path_(image_path), random_(options.seed) {}
+
+  bool run();
+
+ private:
+  void iterate();
+  void set_fixed_menu();
+  void set_menu(FlValue* menu_list);
+  FlValue* random_menu_list(int depth);
+  FlValue* random_menu_item(int depth);
+  void update_random_item();
+  void call(FlMethodResponse* response);
+  Sample sample();
+  bool check(const Sample& baseline, const Sample& current);
+
+  int random_int(int min, int max) {
+    return std::uniform_int_distribution<int>(min, max)(random_);
+  }
+
+  const Options& options_;
+  std::string image_path_;
+  std::mt19937 random_;
+
+  std::shared_ptr<SoakMenuManager> menu_manager_;
+  std::unique_ptr<SoakTray> tray_;
+
+  int64_t generation_ = 0;
+  int64_t next_item_id_ = 0;
+  std::vector<int64_t> item_ids_;
+};
+
+bool Soak::run() {
+  menu_manager_ = std::make_shared<SoakMenuManager>();
+  tray_ = std::make_unique<SoakTray>(menu_manager_);
+
+  g_autoptr(FlValue) init_args = fl_value_new_map();
+  fl_value_set_string_take(init_args, "tray_id",
+                           fl_value_new_string("system_tray_soak"));
+  call(tray_->init_tray(init_args));
+
+  for (int i = 0; i < kWarmupIterations; ++i) {
+    iterate();
+  }
+
+  set_fixed_menu();
+  Sample baseline = sample();
+
+  int64_t iterations = 0;
+  gint64 end_time =
+      g_get_monotonic_time() +
+      static_cast<gint64>(options_.duration * G_USEC_PER_SEC);
+  while (g_get_monotonic_time() < end_time) {
+    iterate();
+    ++iterations;
+  }
+
+  set_fixed_menu();
+  Sample current = sample();
+  printf("iterations: %" G_GINT64_FORMAT "\n", iterations);
+
+  bool ok = check(baseline, current);
+
+  tray_.reset();
+  menu_manager_.reset();
+  return ok;
+}
+
+void Soak::iterate() {
+  item_ids_.clear();
+  set_menu(random_menu_list(0));
+
+  int updates = random_int(0, 8);
+  for (int i = 0; i < updates; ++i) {
+    update_random_item();
+  }
+
+  g_autoptr(FlValue) info_args = fl_value_new_map();
+  fl_value_set_string_take(
+      info_args, "title",
+      fl_value_new_string(std::to_string(generation_).c_str()));
+  fl_value_set_string_take(info_args, "iconpath",
+                           fl_value_new_string(image_path_.c_str()));
+  call(tray_->set_tray_info(info_args));
+
+  g_autoptr(FlValue) context_menu_args = fl_value_new_int(1);
+  call(tray_->set_context_menu(context_menu_args));
+
+  while (gtk_events_pending()) {
+    gtk_main_iteration();
+  }
+}
+
+// Samples are taken with the same single-item menu in place, so that the
+// number of live widgets doesn't depend on the last random tree.
+void Soak::set_fixed_menu() {
+  FlValue* item = fl_value_new_map();
+  fl_value_set_string_take(item, "type", fl_value_new_string("label"));
+  fl_value_set_string_take(item, "id", fl_value_new_int(++next_item_id_));
+  fl_value_set_string_take(item, "label", fl_value_new_string("Fixed"));
+
+  FlValue* menu_list = fl_value_new_list();
+  fl_value_append_take(menu_list, item);
+  set_menu(menu_list);
+
+  g_autoptr(FlValue) context_menu_args = fl_value_new_int(1);
+  call(tray_->set_context_menu(context_menu_args));
+
+  while (gtk_events_pending()) {
+    gtk_main_iteration();
+  }
+}
+
+// Takes ownership of |menu_list|.
+void Soak::set_menu(FlValue* menu_list) {
+  g_autoptr(FlValue) menu_args = fl_value_new_map();
+  fl_value_set_string_take(menu_args, "menu_id", fl_value_new_int(1));
+  fl_value_set_string_take(menu_args, "generation",
+                           fl_value_new_int(++generation_));
+  fl_value_set_string_take(menu_args, "menu_list", menu_list);
+  call(menu_manager_->create_context_menu(menu_args));
+}
+
+FlValue* Soak::random_menu_list(int depth) {
+  FlValue* list = fl_value_new_list();
+  int count = random_int(1, kMaxMenuItems);
+  for (int i = 0; i < count; ++i) {
+    fl_value_append_take(list, random_menu_item(depth));
+  }
+  return list;
+}
+
+FlValue* Soak::random_menu_item(int depth) {
+  FlValue* item = fl_value_new_map();
+
+  int kind = random_int(0, depth < kMaxSubMenuDepth ? 4 : 3);
+  if (kind == 0) {
+    fl_value_set_string_take(item, "type", fl_value_new_string("separator"));
+    return item;
+  }
+
+  int64_t id = ++next_item_id_;
+  fl_value_set_string_take(item, "id", fl_value_new_int(id));
+  std::string label = "Item " + std::to_string(id);
+  fl_value_set_string_take(item, "label", fl_value_new_string(label.c_str()));
+  fl_value_set_string_take(item, "enabled",
+                           fl_value_new_bool(random_int(0, 1) == 1));
+
+  if (kind == 1) {
+    fl_value_set_string_take(item, "type", fl_value_new_string("label"));
+  } else if (kind == 2) {
+    fl_value_set_string_take(item, "type", fl_value_new_string("label"));
+    fl_value_set_string_take(item, "image",
+                             fl_value_new_string(image_path_.c_str()));
+  } else if (kind == 3) {
+    fl_value_set_string_take(item, "type", fl_value_new_string("checkbox"));
+    fl_value_set_string_take(item, "checked",
+                             fl_value_new_bool(random_int(0, 1) == 1));
+  } else {
+    fl_value_set_string_take(item, "type", fl_value_new_string("submenu"));
+    fl_value_set_string_take(item, "submenu", random_menu_list(depth + 1));
+    return item;
+  }
+
+  item_ids_.push_back(id);
+  return item;
+}
+
+void Soak::update_random_item() {
+  if (item_ids_.empty()) {
+    return;
+  }
+
+  int64_t id = item_ids_[random_int(0, item_ids_.size() - 1)];
+
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "menu_id", fl_value_new_int(1));
+  fl_value_set_string_take(args, "menu_item_id", fl_value_new_int(id));
+
+  switch (random_int(0, 3)) {
+    case 0:
+      fl_value_set_string_take(args, "label", fl_value_new_string("Updated"));
+      call(menu_manager_->set_label(args));
+      break;
+    case 1:
+      fl_value_set_string_take(args, "image",
+                               fl_value_new_string(image_path_.c_str()));
+      call(menu_manager_->set_image(args));
+      break;
+    case 2:
+      fl_value_set_string_take(args, "enabled",
+                               fl_value_new_bool(random_int(0, 1) == 1));
+      call(menu_manager_->set_enable(args));
+      break;
+    default:
+      fl_value_set_string_take(args, "checked",
+                               fl_value_new_bool(random_int(0, 1) == 1));
+      call(menu_manager_->set_check(args));
+      break;
+  }
+}
+
+void Soak::call(FlMethodResponse* response) {
+  // Errors are expected, e.g. checking an item that isn't a checkbox; only the
+  // resources matter here.
+  if (response) {
+    g_object_unref(response);
+  }
+}
+
+Sample Soak::sample() {
+  Sample result;
+  result.rss = utils::get_resident_set_size();
+  result.fds = utils::get_open_fd_count();
+  for (const char* type_name : kTrackedTypes) {
+    GType type = g_type_from_name(type_name);
+    result.objects.push_back(type ? g_type_get_instance_count(type) : 0);
+  }
+  return result;
+}
+
+bool Soak::check(const Sample& baseline, const Sample& current) {
+  bool ok = true;
+
+  int64_t rss_growth_kb = (current.rss - baseline.rss) / 1024;
+  printf("rss: %" G_GINT64_FORMAT " KiB -> %" G_GINT64_FORMAT
+         " KiB (+%" G_GINT64_FORMAT " KiB, limit %" G_GINT64_FORMAT ")\n",
+         baseline.rss / 1024, current.rss / 1024, rss_growth_kb,
+         options_.rss_growth_kb);
+  if (rss_growth_kb > options_.rss_growth_kb) {
+    ok = false;
+  }
+
+  int64_t fd_growth = current.fds - baseline.fds;
+  printf("fds: %" G_GINT64_FORMAT " -> %" G_GINT64_FORMAT
+         " (limit +%" G_GINT64_FORMAT ")\n",
+         baseline.fds, current.fds, options_.fd_growth);
+  if (fd_growth > options_.fd_growth) {
+    ok = false;
+  }
+
+  for (size_t i = 0; i < G_N_ELEMENTS(kTrackedTypes); ++i) {
+    int64_t growth = current.objects[i] - baseline.objects[i];
+    printf("%s: %" G_GINT64_FORMAT " -> %" G_GINT64_FORMAT
+           " (limit +%" G_GINT64_FORMAT ")\n",
+           kTrackedTypes[i], baseline.objects[i], current.objects[i],
+           options_.object_growth);
+    if (growth > options_.object_growth) {
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+bool parse_options(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = strchr(arg, '=');
+    if (!value) {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return false;
+    }
+    ++value;
+
+    if (g_str_has_prefix(arg, "--duration=")) {
+      options->duration = g_ascii_strtod(value, nullptr);
+    } else if (g_str_has_prefix(arg, "--rss-growth-kb=")) {
+      options->rss_growth_kb = g_ascii_strtoll(value, nullptr, 10);
+    } else if (g_str_has_prefix(arg, "--object-growth=")) {
+      options->object_growth = g_ascii_strtoll(value, nullptr, 10);
+    } else if (g_str_has_prefix(arg, "--fd-growth=")) {
+      options->fd_growth = g_ascii_strtoll(value, nullptr, 10);
+    } else if (g_str_has_prefix(arg, "--seed=")) {
+      options->seed = g_ascii_strtoull(value, nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Instance counting is decided when GLib starts, so restart with it enabled.
+  const char* debug = getenv("GOBJECT_DEBUG");
+  if (!debug || !strstr(debug, "instance-count")) {
+    setenv("GOBJECT_DEBUG", "instance-count", 1);
+    execv("/proc/self/exe", argv);
+    fprintf(stderr, "Failed to restart with GOBJECT_DEBUG=instance-count\n");
+    return 1;
+  }
+
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    return 1;
+  }
+
+  g_autofree gchar* temp_dir =
+      g_dir_make_tmp("system_tray_soak_XXXXXX", nullptr);
+  if (!temp_dir) {
+    fprintf(stderr, "Failed to create a temporary directory\n");
+    return 1;
+  }
+  // Keep rasterized icons out of the user's cache.
+  g_autofree gchar* cache_dir = g_build_filename(temp_dir, "cache", nullptr);
+  setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+  if (!gtk_init_check(&argc, &argv)) {
+    fprintf(stderr, "No display available, skipping\n");
+    return kSkipReturnCode;
+  }
+
+  std::string image_path =
+      write_test_image(temp_dir, "icon.png", 0x3366ccff);
+  if (image_path.empty()) {
+    return 1;
+  }
+
+  headless_indicator_install();
+
+  bool ok = Soak(options, image_path).run();
+
+  remove_recursively(temp_dir);
+
+  printf("%s\n", ok ? "PASSED" : "FAILED");
+  return ok ? 0 : 1;
+}
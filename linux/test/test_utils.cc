@@ -0,0 +1,34 @@
+#include "test_utils.h"
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+std::string write_test_image(const gchar* dir,
+                             const gchar* name,
+                             guint32 rgba) {
+  g_autoptr(GdkPixbuf) pixbuf =
+      gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 32, 32);
+  gdk_pixbuf_fill(pixbuf, rgba);
+
+  g_autofree gchar* path = g_build_filename(dir, name, nullptr);
+  g_autoptr(GError) error = nullptr;
+  if (!gdk_pixbuf_save(pixbuf, path, "png", &error, nullptr)) {
+    fprintf(stderr, "Failed to write %s: %s\n", path, error->message);
+    return std::string();
+  }
+  return path;
+}
+
+void remove_recursively(const gchar* path) {
+  GDir* dir = g_dir_open(path, 0, nullptr);
+  if (dir) {
+    const gchar* name = nullptr;
+    while ((name = g_dir_read_name(dir)) != nullptr) {
+      g_autofree gchar* child = g_build_filename(path, name, nullptr);
+      remove_recursively(child);
+    }
+    g_dir_close(dir);
+  }
+  g_remove(path);
+}
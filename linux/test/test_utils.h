@@ -0,0 +1,15 @@
+#ifndef __TEST_UTILS_H__
+#define __TEST_UTILS_H__
+
+#include <glib.h>
+
+#include <string>
+
+// Writes a 32x32 PNG filled with |rgba| to |dir|/|name| and returns its path,
+// or an empty string on failure.
+std::string write_test_image(const gchar* dir, const gchar* name, guint32 rgba);
+
+// Deletes |path| and, if it is a directory, everything below it.
+void remove_recursively(const gchar* path);
+
+#endif  // __TEST_UTILS_H__
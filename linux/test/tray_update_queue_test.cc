@@ -0,0 +1,132 @@
+// Unit tests for the queue behind system_tray_api.h.
+//
+// Usage: system_tray_update_queue_test
+
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../tray_update_queue.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                             \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__,     \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (false)
+
+TrayUpdate label_update(int64_t menu_item_id, const std::string& label) {
+  TrayUpdate update;
+  update.field = TrayUpdateField::kMenuItemLabel;
+  update.menu_item_id = menu_item_id;
+  update.text = label;
+  return update;
+}
+
+void test_order_and_wake_up() {
+  TrayUpdateQueue queue;
+  EXPECT(queue.take().empty());
+
+  EXPECT(queue.push(label_update(1, "a")));
+  EXPECT(!queue.push(label_update(2, "b")));
+
+  TrayUpdate icon;
+  icon.field = TrayUpdateField::kIcon;
+  icon.text = "icon.png";
+  EXPECT(!queue.push(icon));
+
+  std::vector<TrayUpdate> updates = queue.take();
+  EXPECT(updates.size() == 3);
+  if (updates.size() == 3) {
+    EXPECT(updates[0].text == "a");
+    EXPECT(updates[1].text == "b");
+    EXPECT(updates[2].field == TrayUpdateField::kIcon);
+  }
+
+  // Empty again, so the next push has to wake up the consumer.
+  EXPECT(queue.push(label_update(1, "c")));
+  EXPECT(queue.take().size() == 1);
+}
+
+void test_collapsing() {
+  TrayUpdateQueue queue;
+  queue.push(label_update(1, "first"));
+  queue.push(label_update(2, "other"));
+  queue.push(label_update(1, "second"));
+
+  TrayUpdate enabled;
+  enabled.field = TrayUpdateField::kMenuItemEnabled;
+  enabled.menu_item_id = 1;
+  enabled.flag = true;
+  queue.push(enabled);
+  enabled.flag = false;
+  queue.push(enabled);
+
+  // Kept at the position of the last update to each field.
+  std::vector<TrayUpdate> updates = queue.take();
+  EXPECT(updates.size() == 3);
+  if (updates.size() == 3) {
+    EXPECT(updates[0].text == "other");
+    EXPECT(updates[1].text == "second");
+    EXPECT(updates[2].field == TrayUpdateField::kMenuItemEnabled);
+    EXPECT(!updates[2].flag);
+  }
+}
+
+void test_producers() {
+  constexpr int kThreads = 8;
+  constexpr int kUpdatesPerThread = 20000;
+
+  TrayUpdateQueue queue;
+  std::atomic<int> running{kThreads};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&queue, &running, t]() {
+      for (int i = 0; i < kUpdatesPerThread; ++i) {
+        queue.push(label_update(t, std::to_string(i)));
+      }
+      --running;
+    });
+  }
+
+  // Each thread's updates must arrive in order, ending with its last one.
+  std::vector<int> last(kThreads, -1);
+  bool in_order = true;
+  for (bool done = false; !done;) {
+    done = running == 0;
+    for (const TrayUpdate& update : queue.take()) {
+      int value = std::stoi(update.text);
+      in_order = in_order && value > last[update.menu_item_id];
+      last[update.menu_item_id] = value;
+    }
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT(in_order);
+  for (int t = 0; t < kThreads; ++t) {
+    EXPECT(last[t] == kUpdatesPerThread - 1);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_order_and_wake_up();
+  test_collapsing();
+  test_producers();
+
+  printf("%s\n", g_failures == 0 ? "PASSED" : "FAILED");
+  return g_failures == 0 ? 0 : 1;
+}
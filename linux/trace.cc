@@ -0,0 +1,182 @@
+#include "trace.h"
+
+#include <string.h>
+
+#include <vector>
+
+constexpr char kTraceEnvironmentVariable[] = "SYSTEM_TRAY_TRACE";
+
+namespace {
+
+constexpr char kTraceMagic[8] = {'S', 'T', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// Payloads larger than this are treated as a corrupt trace.
+constexpr uint32_t kMaxPayloadLength = 64 * 1024 * 1024;
+
+}  // namespace
+
+TraceRecord::~TraceRecord() noexcept {
+  if (args) {
+    fl_value_unref(args);
+    args = nullptr;
+  }
+}
+
+// static
+std::unique_ptr<TraceWriter> TraceWriter::create_from_environment() {
+  const gchar* path = g_getenv(kTraceEnvironmentVariable);
+  if (!path || !*path) {
+    return nullptr;
+  }
+
+  // Earlier runs are kept, e.g. the one that crashed before a restart.
+  FILE* file = fopen(path, "ab+");
+  if (!file) {
+    g_warning("Failed to open trace file %s", path);
+    return nullptr;
+  }
+
+  char magic[sizeof(kTraceMagic)] = {};
+  if (fseek(file, 0, SEEK_END) == 0 && ftell(file) == 0) {
+    if (fwrite(kTraceMagic, sizeof(kTraceMagic), 1, file) != 1) {
+      g_warning("Failed to write trace file %s", path);
+      fclose(file);
+      return nullptr;
+    }
+  } else if (fseek(file, 0, SEEK_SET) != 0 ||
+             fread(magic, sizeof(magic), 1, file) != 1 ||
+             memcmp(magic, kTraceMagic, sizeof(magic)) != 0) {
+    g_warning("%s is not a trace file", path);
+    fclose(file);
+    return nullptr;
+  }
+  // Records are appended either way, but a write can't directly follow a
+  // read on the same stream.
+  fseek(file, 0, SEEK_END);
+
+  g_message("Recording method calls to %s", path);
+  return std::make_unique<TraceWriter>(file);
+}
+
+TraceWriter::TraceWriter(FILE* file) noexcept
+    : file_(file), codec_(fl_standard_message_codec_new()) {}
+
+TraceWriter::~TraceWriter() noexcept {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+
+  g_clear_object(&codec_);
+}
+
+void TraceWriter::record(TraceChannel channel,
+                         const gchar* method,
+                         FlValue* args) {
+  gint64 now = g_get_monotonic_time();
+  if (start_time_ == 0) {
+    start_time_ = now;
+  }
+
+  g_autoptr(FlValue) message = fl_value_new_list();
+  fl_value_append_take(message, fl_value_new_string(method));
+  fl_value_append_take(message,
+                       args ? fl_value_ref(args) : fl_value_new_null());
+
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GBytes) payload = fl_message_codec_encode_message(
+      FL_MESSAGE_CODEC(codec_), message, &error);
+  if (!payload) {
+    g_warning("Failed to encode %s for the trace: %s", method, error->message);
+    return;
+  }
+
+  gsize length = 0;
+  const void* data = g_bytes_get_data(payload, &length);
+
+  guint64 time_us = GUINT64_TO_LE(static_cast<guint64>(now - start_time_));
+  uint8_t channel_id = static_cast<uint8_t>(channel);
+  guint32 payload_length = GUINT32_TO_LE(static_cast<guint32>(length));
+
+  fwrite(&time_us, sizeof(time_us), 1, file_);
+  fwrite(&channel_id, sizeof(channel_id), 1, file_);
+  fwrite(&payload_length, sizeof(payload_length), 1, file_);
+  fwrite(data, 1, length, file_);
+
+  // Keep the trace usable if the application crashes, which is when it is
+  // most likely to be attached to a bug report.
+  fflush(file_);
+}
+
+TraceReader::TraceReader() noexcept
+    : codec_(fl_standard_message_codec_new()) {}
+
+TraceReader::~TraceReader() noexcept {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+
+  g_clear_object(&codec_);
+}
+
+bool TraceReader::open(const char* path) {
+  file_ = fopen(path, "rb");
+  if (!file_) {
+    return false;
+  }
+
+  char magic[sizeof(kTraceMagic)] = {};
+  return fread(magic, sizeof(magic), 1, file_) == 1 &&
+         memcmp(magic, kTraceMagic, sizeof(magic)) == 0;
+}
+
+bool TraceReader::next(TraceRecord* record) {
+  if (!file_) {
+    return false;
+  }
+
+  guint64 time_us = 0;
+  uint8_t channel_id = 0;
+  guint32 payload_length = 0;
+  if (fread(&time_us, sizeof(time_us), 1, file_) != 1 ||
+      fread(&channel_id, sizeof(channel_id), 1, file_) != 1 ||
+      fread(&payload_length, sizeof(payload_length), 1, file_) != 1) {
+    return false;
+  }
+
+  payload_length = GUINT32_FROM_LE(payload_length);
+  if (channel_id > static_cast<uint8_t>(TraceChannel::kAppWindow) ||
+      payload_length > kMaxPayloadLength) {
+    return false;
+  }
+
+  std::vector<uint8_t> data(payload_length);
+  if (payload_length > 0 &&
+      fread(data.data(), 1, payload_length, file_) != payload_length) {
+    return false;
+  }
+
+  g_autoptr(GBytes) payload = g_bytes_new(data.data(), data.size());
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(FlValue) message = fl_message_codec_decode_message(
+      FL_MESSAGE_CODEC(codec_), payload, &error);
+  if (!message || fl_value_get_type(message) != FL_VALUE_TYPE_LIST ||
+      fl_value_get_length(message) != 2) {
+    return false;
+  }
+
+  FlValue* method = fl_value_get_list_value(message, 0);
+  if (fl_value_get_type(method) != FL_VALUE_TYPE_STRING) {
+    return false;
+  }
+
+  record->time_us = static_cast<int64_t>(GUINT64_FROM_LE(time_us));
+  record->channel = static_cast<TraceChannel>(channel_id);
+  record->method = fl_value_get_string(method);
+  if (record->args) {
+    fl_value_unref(record->args);
+  }
+  record->args = fl_value_ref(fl_value_get_list_value(message, 1));
+  return true;
+}
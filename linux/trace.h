@@ -0,0 +1,76 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <flutter_linux/flutter_linux.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+// Method call traces, recorded when SYSTEM_TRAY_TRACE names a file and
+// replayed by linux/test/replay_trace.cc.
+//
+// A trace starts with kTraceMagic followed by one record per method call:
+//   uint64 time since the first call in microseconds, little endian
+//   uint8  channel, see TraceChannel
+//   uint32 payload length, little endian
+//   payload: [method, args] encoded with the standard message codec
+//
+// Each run of the application appends its calls to the same trace, with
+// times starting over from its first call.
+
+extern const char kTraceEnvironmentVariable[];
+
+enum class TraceChannel : uint8_t {
+  kTray = 0,
+  kMenuManager = 1,
+  kAppWindow = 2,
+};
+
+struct TraceRecord {
+  int64_t time_us = 0;
+  TraceChannel channel = TraceChannel::kTray;
+  std::string method;
+  FlValue* args = nullptr;
+
+  TraceRecord() = default;
+  TraceRecord(const TraceRecord&) = delete;
+  TraceRecord& operator=(const TraceRecord&) = delete;
+  ~TraceRecord() noexcept;
+};
+
+class TraceWriter {
+ public:
+  // Returns a writer appending to the file named by SYSTEM_TRAY_TRACE, or
+  // nullptr if it isn't set, can't be opened or isn't a trace.
+  static std::unique_ptr<TraceWriter> create_from_environment();
+
+  TraceWriter(FILE* file) noexcept;
+  ~TraceWriter() noexcept;
+
+  void record(TraceChannel channel, const gchar* method, FlValue* args);
+
+ protected:
+  FILE* file_ = nullptr;
+  FlStandardMessageCodec* codec_ = nullptr;
+  gint64 start_time_ = 0;
+};
+
+class TraceReader {
+ public:
+  TraceReader() noexcept;
+  ~TraceReader() noexcept;
+
+  bool open(const char* path);
+
+  // Reads the next record into |record|. Returns false at the end of the trace
+  // or if it is malformed.
+  bool next(TraceRecord* record);
+
+ protected:
+  FILE* file_ = nullptr;
+  FlStandardMessageCodec* codec_ = nullptr;
+};
+
+#endif  // __TRACE_H__
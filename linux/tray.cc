@@ -4,9 +4,12 @@
 #include "tray.h"
 
 #include <assert.h>
-#include <dlfcn.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#endif
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -14,6 +17,7 @@
 #include <string>
 
 #include "errors.h"
+#include "icon_cache.h"
 #include "menu.h"
 #include "menu_manager.h"
 
@@ -23,6 +27,9 @@ constexpr char kSetContextMenu[] = "SetContextMenu";
 constexpr char kPopupContextMenu[] = "PopupContextMenu";
 constexpr char kGetTitle[] = "GetTitle";
 constexpr char kDestroySystemTray[] = "DestroySystemTray";
+constexpr char kSetImageFrame[] = "SetImageFrame";
+constexpr char kRegisterTrayStates[] = "RegisterTrayStates";
+constexpr char kSetTrayState[] = "SetTrayState";
 
 namespace {
 
@@ -30,6 +37,50 @@ constexpr char kTrayIdKey[] = "tray_id";
 constexpr char kTitleKey[] = "title";
 constexpr char kIconPathKey[] = "iconpath";
 constexpr char kToolTipKey[] = "tooltip";
+constexpr char kWidthKey[] = "width";
+constexpr char kHeightKey[] = "height";
+constexpr char kRgbaKey[] = "rgba";
+constexpr char kNameKey[] = "name";
+constexpr char kStatusKey[] = "status";
+constexpr char kStatusActive[] = "active";
+constexpr char kStatusAttention[] = "attention";
+constexpr char kStatusPassive[] = "passive";
+
+// Rate cap for raw icon frames, so a fast stream from Dart doesn't make the
+// panel reload the icon more often than it can draw it.
+constexpr gint64 kMinImageFrameIntervalMs = 50;
+
+// Dart numbers its menus from 1, so the restored menu can't clash with them.
+constexpr int64_t kSnapshotMenuId = 0;
+constexpr char kMenuIdKey[] = "menu_id";
+constexpr char kMenuListKey[] = "menu_list";
+
+// Coalesces the calls Dart makes while setting up the tray into one write.
+constexpr guint kSaveSnapshotDelaySeconds = 1;
+
+// How long a restored tray waits for Dart, e.g. when the application no
+// longer shows a tray at all.
+constexpr guint kRestoreTimeoutSeconds = 5;
+
+constexpr char kRestoreOnLaunchKey[] = "restore_on_launch";
+
+// appindicator only takes icon paths, so frames are written to the user's
+// runtime directory (a tmpfs) under two alternating names; reusing a single
+// name would let the panel serve its cached copy. The directory is created
+// along with the first frame.
+std::string image_frame_path(int index) {
+  static const std::string dir = [] {
+    g_autofree gchar* path =
+        g_build_filename(g_get_user_runtime_dir(), "system_tray", nullptr);
+    g_mkdir_with_parents(path, 0700);
+    return std::string(path);
+  }();
+
+  g_autofree gchar* name =
+      g_strdup_printf("%d-frame-%d.png", static_cast<int>(getpid()), index);
+  g_autofree gchar* path = g_build_filename(dir.c_str(), name, nullptr);
+  return path;
+}
 
 }  // namespace
 
@@ -37,8 +88,94 @@ Tray::Tray(FlMethodChannel* channel,
            std::weak_ptr<MenuManager> menu_manager) noexcept
     : channel_(channel), menu_manager_(menu_manager) {}
 
+// static
+gboolean Tray::static_image_frame_timeout_callback_fun(gpointer user_data) {
+  Tray* self = reinterpret_cast<Tray*>(user_data);
+  self->image_frame_timer_id_ = 0;
+  self->flush_image_frame();
+  return G_SOURCE_REMOVE;
+}
+
+// static
+gboolean Tray::static_prepare_popup_idle_callback_fun(gpointer user_data) {
+  Tray* self = reinterpret_cast<Tray*>(user_data);
+  self->prepare_popup_idle_id_ = 0;
+
+  std::shared_ptr<Menu> menu = self->get_context_menu();
+  if (menu) {
+    menu->prepare_popup();
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// static
+gboolean Tray::static_save_snapshot_timeout_callback_fun(gpointer user_data) {
+  Tray* self = reinterpret_cast<Tray*>(user_data);
+  self->save_snapshot_timer_id_ = 0;
+  self->save_snapshot();
+  return G_SOURCE_REMOVE;
+}
+
+// static
+gboolean Tray::static_restore_timeout_callback_fun(gpointer user_data) {
+  Tray* self = reinterpret_cast<Tray*>(user_data);
+  self->restore_timer_id_ = 0;
+  self->drop_restored_tray();
+  return G_SOURCE_REMOVE;
+}
+
+// static
+void Tray::static_monitors_changed_callback_fun(GdkScreen* screen,
+                                                Tray* self) {
+  self->monitors_changed_callback_fun(screen);
+}
+
+void Tray::monitors_changed_callback_fun(GdkScreen* screen) {
+  int scale_factor = icon_cache_scale_factor();
+  if (scale_factor == scale_factor_) {
+    return;
+  }
+
+  scale_factor_ = scale_factor;
+
+  // Frames are shown as Dart drew them; show the current one again rather
+  // than the static icon it replaced.
+  if (app_indicator_ && image_frame_shown_) {
+    indicator_api_->app_indicator_set_icon_full(
+        app_indicator_, image_frame_path(image_frame_file_index_).c_str(),
+        "icon");
+  } else if (app_indicator_ && !icon_path_.empty()) {
+    set_icon(icon_path_.c_str());
+  }
+
+  if (app_indicator_ && !attention_icon_path_.empty()) {
+    set_attention_icon(attention_icon_path_.c_str());
+  }
+
+  if (!menu_manager_.expired()) {
+    std::shared_ptr<MenuManager> menu_manager = menu_manager_.lock();
+    menu_manager->refresh_images();
+  }
+}
+
 Tray::~Tray() noexcept {
+  if (screen_) {
+    g_signal_handlers_disconnect_by_data(screen_, this);
+    screen_ = nullptr;
+  }
+
+  // Don't lose the last changes when the application quits right after them.
+  if (save_snapshot_timer_id_ != 0) {
+    g_source_remove(save_snapshot_timer_id_);
+    save_snapshot_timer_id_ = 0;
+    save_snapshot();
+  }
+
+  cancel_restore_timeout();
+  cancel_prepare_popup();
+  cancel_image_frame();
   destroy_indicator();
+  remove_image_frames();
 
   channel_ = nullptr;
 }
@@ -47,45 +184,16 @@ bool Tray::init_indicator_api() {
   bool ret = false;
 
   do {
-    if (indicator_api_inited_) {
+    if (indicator_api_) {
       ret = true;
       break;
     }
 
-    void* handle = dlopen("libappindicator3.so.1", RTLD_LAZY);
-    if (!handle) {
+    indicator_api_ = indicator_api_get();
+    if (!indicator_api_) {
       break;
     }
 
-    app_indicator_new_ = reinterpret_cast<app_indicator_new_fun>(
-        dlsym(handle, "app_indicator_new"));
-    app_indicator_set_status_ = reinterpret_cast<app_indicator_set_status_fun>(
-        dlsym(handle, "app_indicator_set_status"));
-    app_indicator_set_icon_full_ =
-        reinterpret_cast<app_indicator_set_icon_full_func>(
-            dlsym(handle, "app_indicator_set_icon_full"));
-    app_indicator_set_attention_icon_full_ =
-        reinterpret_cast<app_indicator_set_attention_icon_full_fun>(
-            dlsym(handle, "app_indicator_set_attention_icon_full"));
-    app_indicator_set_label_ = reinterpret_cast<app_indicator_set_label_func>(
-        dlsym(handle, "app_indicator_set_label"));
-    app_indicator_set_title_ = reinterpret_cast<app_indicator_set_title_func>(
-        dlsym(handle, "app_indicator_set_title"));
-    app_indicator_get_label_ = reinterpret_cast<app_indicator_get_label_func>(
-        dlsym(handle, "app_indicator_get_label"));
-    app_indicator_set_menu_ = reinterpret_cast<app_indicator_set_menu_fun>(
-        dlsym(handle, "app_indicator_set_menu"));
-
-    if (!app_indicator_new_ || !app_indicator_set_status_ ||
-        !app_indicator_set_icon_full_ ||
-        !app_indicator_set_attention_icon_full_ || !app_indicator_set_label_ ||
-        !app_indicator_set_label_ || !app_indicator_get_label_ ||
-        !app_indicator_set_menu_) {
-      break;
-    }
-
-    indicator_api_inited_ = true;
-
     ret = true;
   } while (false);
 
@@ -102,19 +210,31 @@ bool Tray::create_indicator(const char* tray_id) {
       break;
     }
 
-    if (!indicator_api_inited_) {
+    if (!indicator_api_) {
       break;
     }
 
     if (!app_indicator_) {
-      app_indicator_ = app_indicator_new_(
+      app_indicator_ = indicator_api_->app_indicator_new(
           tray_id, "", APP_INDICATOR_CATEGORY_APPLICATION_STATUS);
       if (!app_indicator_) {
         break;
       }
+      tray_id_ = tray_id;
     }
 
-    app_indicator_set_status_(app_indicator_, APP_INDICATOR_STATUS_ACTIVE);
+    if (!screen_) {
+      screen_ = gdk_screen_get_default();
+      scale_factor_ = icon_cache_scale_factor();
+      if (screen_) {
+        g_signal_connect(
+            G_OBJECT(screen_), "monitors-changed",
+            G_CALLBACK(Tray::static_monitors_changed_callback_fun), this);
+      }
+    }
+
+    indicator_api_->app_indicator_set_status(app_indicator_,
+                                             APP_INDICATOR_STATUS_ACTIVE);
     ret = true;
   } while (false);
 
@@ -123,6 +243,7 @@ bool Tray::create_indicator(const char* tray_id) {
 
 void Tray::destroy_indicator() {
   context_menu_id_ = -1;
+  disconnect_menu_root();
 
   if (app_indicator_) {
     g_object_unref(G_OBJECT(app_indicator_));
@@ -134,15 +255,24 @@ void Tray::hide_indicator() {
   context_menu_id_ = -1;
 
   if (app_indicator_) {
-    app_indicator_set_status_(app_indicator_, APP_INDICATOR_STATUS_PASSIVE);
+    indicator_api_->app_indicator_set_status(app_indicator_,
+                                             APP_INDICATOR_STATUS_PASSIVE);
   }
 }
 
 void Tray::handle_method_call(FlMethodCall* method_call) {
-  g_autoptr(FlMethodResponse) response = nullptr;
+  g_autoptr(FlMethodResponse) response =
+      handle_method(fl_method_call_get_name(method_call),
+                    fl_method_call_get_args(method_call));
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
 
-  const gchar* method = fl_method_call_get_name(method_call);
-  FlValue* args = fl_method_call_get_args(method_call);
+FlMethodResponse* Tray::handle_method(const gchar* method, FlValue* args) {
+  FlMethodResponse* response = nullptr;
 
   // g_print("method call %s\n", method);
 
@@ -158,14 +288,17 @@ void Tray::handle_method_call(FlMethodCall* method_call) {
     response = get_title(args);
   } else if (strcmp(method, kDestroySystemTray) == 0) {
     response = destroy_system_tray(args);
+  } else if (strcmp(method, kSetImageFrame) == 0) {
+    response = set_image_frame(args);
+  } else if (strcmp(method, kRegisterTrayStates) == 0) {
+    response = register_tray_states(args);
+  } else if (strcmp(method, kSetTrayState) == 0) {
+    response = set_tray_state(args);
   } else {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
 
-  g_autoptr(GError) error = nullptr;
-  if (!fl_method_call_respond(method_call, response, &error)) {
-    g_warning("Failed to send method call response: %s", error->message);
-  }
+  return response;
 }
 
 FlMethodResponse* Tray::init_tray(FlValue* args) {
@@ -187,10 +320,27 @@ FlMethodResponse* Tray::init_tray(FlValue* args) {
       tray_id = fl_value_get_string(tray_id_value);
     }
 
+    bool restore_on_launch = false;
+    FlValue* restore_on_launch_value =
+        fl_value_lookup_string(args, kRestoreOnLaunchKey);
+    if (restore_on_launch_value &&
+        fl_value_get_type(restore_on_launch_value) == FL_VALUE_TYPE_BOOL) {
+      restore_on_launch = fl_value_get_bool(restore_on_launch_value);
+    }
+
+    // Dart took over the restored tray, if any.
+    cancel_restore_timeout();
+
     if (!init_tray(tray_id)) {
       break;
     }
 
+    // Applications that stop asking for it don't get the old tray back.
+    set_snapshot_enabled(restore_on_launch);
+    if (!restore_on_launch) {
+      TraySnapshot::remove();
+    }
+
     response = set_tray_info(args);
 
   } while (false);
@@ -269,7 +419,7 @@ FlMethodResponse* Tray::set_context_menu(FlValue* args) {
 }
 
 FlMethodResponse* Tray::popup_context_menu(FlValue* args) {
-  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  g_autoptr(FlValue) result = fl_value_new_bool(popup_context_menu());
   return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 }
 
@@ -282,7 +432,8 @@ FlMethodResponse* Tray::get_title(FlValue* args) {
       break;
     }
 
-    const gchar* title = app_indicator_get_label_(app_indicator_);
+    const gchar* title =
+        indicator_api_->app_indicator_get_label(app_indicator_);
     result = fl_value_new_string(title ? title : "");
 
   } while (false);
@@ -303,6 +454,165 @@ FlMethodResponse* Tray::destroy_system_tray(FlValue* args) {
     }
 
     hide_indicator();
+    cancel_image_frame();
+    remove_image_frames();
+
+    if (save_snapshot_timer_id_ != 0) {
+      g_source_remove(save_snapshot_timer_id_);
+      save_snapshot_timer_id_ = 0;
+    }
+    if (snapshot_enabled_) {
+      TraySnapshot::remove();
+    }
+
+    result = fl_value_new_bool(TRUE);
+
+  } while (false);
+
+  if (nullptr == response) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  return response;
+}
+
+FlMethodResponse* Tray::set_image_frame(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  FlMethodResponse* response = nullptr;
+
+  do {
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    FlValue* width_value = fl_value_lookup_string(args, kWidthKey);
+    FlValue* height_value = fl_value_lookup_string(args, kHeightKey);
+    FlValue* rgba_value = fl_value_lookup_string(args, kRgbaKey);
+    if (!width_value || fl_value_get_type(width_value) != FL_VALUE_TYPE_INT ||
+        !height_value ||
+        fl_value_get_type(height_value) != FL_VALUE_TYPE_INT ||
+        !rgba_value ||
+        fl_value_get_type(rgba_value) != FL_VALUE_TYPE_UINT8_LIST) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    if (!set_image_frame(fl_value_get_int(width_value),
+                         fl_value_get_int(height_value), rgba_value)) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    result = fl_value_new_bool(TRUE);
+
+  } while (false);
+
+  if (nullptr == response) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  return response;
+}
+
+FlMethodResponse* Tray::register_tray_states(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  FlMethodResponse* response = nullptr;
+
+  do {
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_LIST) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    std::unordered_map<std::string, TrayState> tray_states;
+    // The icon of the first attention state, in the order Dart gave them.
+    std::string attention_icon_path;
+
+    for (size_t i = 0; i < fl_value_get_length(args); ++i) {
+      FlValue* state_value = fl_value_get_list_value(args, i);
+      if (fl_value_get_type(state_value) != FL_VALUE_TYPE_MAP) {
+        continue;
+      }
+
+      FlValue* name_value = fl_value_lookup_string(state_value, kNameKey);
+      if (!name_value ||
+          fl_value_get_type(name_value) != FL_VALUE_TYPE_STRING) {
+        continue;
+      }
+
+      TrayState state;
+
+      FlValue* icon_path_value =
+          fl_value_lookup_string(state_value, kIconPathKey);
+      if (icon_path_value &&
+          fl_value_get_type(icon_path_value) == FL_VALUE_TYPE_STRING) {
+        state.icon_path = fl_value_get_string(icon_path_value);
+      }
+
+      FlValue* title_value = fl_value_lookup_string(state_value, kTitleKey);
+      if (title_value &&
+          fl_value_get_type(title_value) == FL_VALUE_TYPE_STRING) {
+        state.label = fl_value_get_string(title_value);
+      }
+
+      FlValue* status_value = fl_value_lookup_string(state_value, kStatusKey);
+      if (status_value &&
+          fl_value_get_type(status_value) == FL_VALUE_TYPE_STRING) {
+        const gchar* status = fl_value_get_string(status_value);
+        if (strcmp(status, kStatusAttention) == 0) {
+          state.status = APP_INDICATOR_STATUS_ATTENTION;
+        } else if (strcmp(status, kStatusPassive) == 0) {
+          state.status = APP_INDICATOR_STATUS_PASSIVE;
+        } else if (strcmp(status, kStatusActive) == 0) {
+          state.status = APP_INDICATOR_STATUS_ACTIVE;
+        }
+      }
+
+      if (state.status == APP_INDICATOR_STATUS_ATTENTION &&
+          attention_icon_path.empty()) {
+        attention_icon_path = state.icon_path;
+      }
+
+      tray_states[fl_value_get_string(name_value)] = std::move(state);
+    }
+
+    tray_states_ = std::move(tray_states);
+
+    // Hand the attention icon to the indicator up front, so switching to that
+    // state later is only a status change.
+    if (app_indicator_ && !attention_icon_path.empty()) {
+      set_attention_icon(attention_icon_path.c_str());
+    }
+
+    result = fl_value_new_bool(TRUE);
+
+  } while (false);
+
+  if (nullptr == response) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  return response;
+}
+
+FlMethodResponse* Tray::set_tray_state(FlValue* args) {
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  FlMethodResponse* response = nullptr;
+
+  do {
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_STRING) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          errors::kBadArgumentsError, "", nullptr));
+      break;
+    }
+
+    if (!set_tray_state(fl_value_get_string(args))) {
+      response = FL_METHOD_RESPONSE(
+          fl_method_error_response_new(errors::kNotFoundError, "", nullptr));
+      break;
+    }
 
     result = fl_value_new_bool(TRUE);
 
@@ -348,17 +658,32 @@ bool Tray::set_tray_info(const char* title,
     }
 
     if (icon_path) {
+      cancel_image_frame();
+
+      icon_path_ = icon_path;
+
       if (strlen(icon_path)) {
-        app_indicator_set_status_(app_indicator_, APP_INDICATOR_STATUS_ACTIVE);
-        app_indicator_set_icon_full_(app_indicator_, icon_path, "icon");
+        indicator_api_->app_indicator_set_status(app_indicator_,
+                                                 APP_INDICATOR_STATUS_ACTIVE);
+        set_icon(icon_path);
       } else {
-        app_indicator_set_status_(app_indicator_, APP_INDICATOR_STATUS_PASSIVE);
+        indicator_api_->app_indicator_set_status(app_indicator_,
+                                                 APP_INDICATOR_STATUS_PASSIVE);
       }
     }
 
     if (title) {
-      app_indicator_set_label_(app_indicator_, title, nullptr);
+      indicator_api_->app_indicator_set_label(app_indicator_, title, nullptr);
+    }
+
+    snapshot_.tray_id = tray_id_;
+    if (icon_path) {
+      snapshot_.icon_path = icon_path;
+    }
+    if (title) {
+      snapshot_.title = title;
     }
+    schedule_save_snapshot();
 
     ret = true;
   } while (false);
@@ -366,16 +691,65 @@ bool Tray::set_tray_info(const char* title,
   return ret;
 }
 
+bool Tray::set_tray_state(const char* name) {
+  auto iter = tray_states_.find(name);
+  if (iter == tray_states_.end() || !app_indicator_) {
+    return false;
+  }
+
+  const TrayState& state = iter->second;
+
+  // A state replaces the frames streamed from Dart.
+  cancel_image_frame();
+
+  if (state.status == APP_INDICATOR_STATUS_ATTENTION) {
+    if (!state.icon_path.empty() && state.icon_path != attention_icon_path_) {
+      set_attention_icon(state.icon_path.c_str());
+    }
+  } else if (!state.icon_path.empty() &&
+             (image_frame_shown_ || state.icon_path != icon_path_)) {
+    icon_path_ = state.icon_path;
+    set_icon(icon_path_.c_str());
+  }
+
+  // A state without a title doesn't keep the label of the previous one.
+  indicator_api_->app_indicator_set_label(app_indicator_, state.label.c_str(),
+                                          nullptr);
+
+  indicator_api_->app_indicator_set_status(app_indicator_, state.status);
+
+  // Restored as a regular icon, which an attention state doesn't change.
+  snapshot_.tray_id = tray_id_;
+  snapshot_.icon_path = icon_path_;
+  snapshot_.title = state.label;
+  schedule_save_snapshot();
+  return true;
+}
+
+void Tray::set_attention_icon(const char* icon_path) {
+  attention_icon_path_ = icon_path;
+
+  std::string icon =
+      icon_cache_lookup(icon_path, kTrayIconSize * scale_factor_);
+  indicator_api_->app_indicator_set_attention_icon_full(
+      app_indicator_, icon.empty() ? icon_path : icon.c_str(), "attention");
+}
+
+void Tray::set_icon(const char* icon_path) {
+  image_frame_shown_ = false;
+
+  std::string icon =
+      icon_cache_lookup(icon_path, kTrayIconSize * scale_factor_);
+  indicator_api_->app_indicator_set_icon_full(
+      app_indicator_, icon.empty() ? icon_path : icon.c_str(), "icon");
+}
+
 void Tray::set_context_menu(int64_t context_menu_id) {
+  int64_t previous_menu_id = context_menu_id_;
   context_menu_id_ = context_menu_id;
 
   do {
-    if (menu_manager_.expired()) {
-      break;
-    }
-
-    std::shared_ptr<MenuManager> menu_manager = menu_manager_.lock();
-    std::shared_ptr<Menu> menu = menu_manager->get_menu(get_context_menu_id());
+    std::shared_ptr<Menu> menu = get_context_menu();
     if (!menu) {
       break;
     }
@@ -384,16 +758,390 @@ void Tray::set_context_menu(int64_t context_menu_id) {
       break;
     }
 
-    GtkWidget* system_menu = menu->get_menu();
+    // Dart rebuilds the whole menu to change a few items. When the structure
+    // is unchanged, update the widgets the indicator already exports instead
+    // of having it send the entire layout to the panel again.
+    std::shared_ptr<Menu> previous_menu;
+    if (previous_menu_id != context_menu_id && !menu_manager_.expired()) {
+      previous_menu = menu_manager_.lock()->get_menu(previous_menu_id);
+    }
+
+    if (!previous_menu || !menu->adopt_widgets(previous_menu.get())) {
+      GtkWidget* system_menu = menu->get_menu();
+
+      gtk_widget_show_all(system_menu);
+      indicator_api_->app_indicator_set_menu(app_indicator_,
+                                             GTK_MENU(system_menu));
+    }
+
+    // Deferred updates are applied when the panel opens the menu, or
+    // periodically if it can't tell.
+    menu->set_flush_on_show(connect_menu_root());
+
+    schedule_prepare_popup();
+
+    if (context_menu_id != kSnapshotMenuId) {
+      deliver_queued_clicks(menu);
+    }
 
-    gtk_widget_show_all(system_menu);
-    app_indicator_set_menu_(app_indicator_, GTK_MENU(system_menu));
+    g_autoptr(FlValue) menu_list = menu->create_menu_list();
+    snapshot_.set_menu_list(menu_list);
+    schedule_save_snapshot();
 
   } while (false);
 }
 
+bool Tray::connect_menu_root() {
+  disconnect_menu_root();
+
+  // Properties of libappindicator and dbusmenu-glib, which are looked up by
+  // name as their headers aren't used. The headless indicator has neither.
+  GObject* indicator = G_OBJECT(app_indicator_);
+  if (!g_object_class_find_property(G_OBJECT_GET_CLASS(indicator),
+                                    "dbus-menu-server")) {
+    return false;
+  }
+
+  g_autoptr(GObject) server = nullptr;
+  g_object_get(indicator, "dbus-menu-server", &server, nullptr);
+  if (!server || !g_object_class_find_property(G_OBJECT_GET_CLASS(server),
+                                               "root-node")) {
+    return false;
+  }
+
+  g_object_get(server, "root-node", &menu_root_, nullptr);
+  if (!menu_root_) {
+    return false;
+  }
+
+  g_signal_connect(menu_root_, "about-to-show",
+                   G_CALLBACK(Tray::static_menu_about_to_show_callback_fun),
+                   this);
+  return true;
+}
+
+void Tray::disconnect_menu_root() {
+  if (menu_root_) {
+    g_signal_handlers_disconnect_by_data(menu_root_, this);
+    g_clear_object(&menu_root_);
+  }
+}
+
+// static
+gboolean Tray::static_menu_about_to_show_callback_fun(GObject* root,
+                                                      Tray* self) {
+  std::shared_ptr<Menu> menu = self->get_context_menu();
+  if (menu) {
+    menu->flush_updates();
+  }
+  // The layout didn't change, only the properties of its items.
+  return FALSE;
+}
+
 int64_t Tray::get_context_menu_id() const {
   return context_menu_id_;
 }
 
+std::shared_ptr<Menu> Tray::get_context_menu() const {
+  if (menu_manager_.expired()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<MenuManager> menu_manager = menu_manager_.lock();
+  return menu_manager->get_menu(get_context_menu_id());
+}
+
+bool Tray::popup_context_menu() {
+  std::shared_ptr<Menu> menu = get_context_menu();
+  if (!menu) {
+    return false;
+  }
+
+  cancel_prepare_popup();
+
+  GtkMenu* system_menu = GTK_MENU(menu->get_menu());
+  menu->flush_updates();
+  gtk_widget_show_all(GTK_WIDGET(system_menu));
+
+  g_autoptr(GdkEvent) event = gtk_get_current_event();
+  if (event && gdk_event_get_window(event)) {
+    gtk_menu_popup_at_pointer(system_menu, event);
+    return true;
+  }
+
+  // Called from Dart there is usually no event being handled, so anchor the
+  // menu at the pointer on the root window instead. Only X11 has a root
+  // window to anchor to; Wayland won't show a popup without a parent surface
+  // and a trigger event.
+  GdkDisplay* display = gdk_display_get_default();
+#ifdef GDK_WINDOWING_X11
+  if (!display || !GDK_IS_X11_DISPLAY(display)) {
+    return false;
+  }
+#else
+  return false;
+#endif
+  GdkSeat* seat = display ? gdk_display_get_default_seat(display) : nullptr;
+  GdkDevice* pointer = seat ? gdk_seat_get_pointer(seat) : nullptr;
+  if (!pointer) {
+    return false;
+  }
+
+  GdkWindow* root_window = gdk_screen_get_root_window(gdk_screen_get_default());
+  GdkRectangle rect = {0, 0, 1, 1};
+  gdk_window_get_device_position(root_window, pointer, &rect.x, &rect.y,
+                                 nullptr);
+  gtk_menu_popup_at_rect(system_menu, root_window, &rect,
+                         GDK_GRAVITY_SOUTH_EAST, GDK_GRAVITY_NORTH_WEST,
+                         nullptr);
+  return true;
+}
+
+void Tray::deliver_queued_clicks(const std::shared_ptr<Menu>& menu) {
+  std::shared_ptr<MenuManager> menu_manager = menu_manager_.lock();
+  std::shared_ptr<Menu> restored_menu =
+      menu_manager ? menu_manager->get_menu(kSnapshotMenuId) : nullptr;
+  if (!restored_menu) {
+    return;
+  }
+
+  // Dart numbers items in build order, so ids match when the menu is built
+  // the same way as last time; the label check catches when it isn't.
+  for (int64_t menu_item_id : restored_menu->take_queued_clicks()) {
+    std::string label = restored_menu->get_label(menu_item_id);
+    if (!label.empty() && menu->get_label(menu_item_id) == label) {
+      menu->activate_menu_item(menu_item_id);
+    }
+  }
+
+  menu_manager->remove_menu(kSnapshotMenuId);
+}
+
+bool Tray::restore_snapshot() {
+  if (app_indicator_) {
+    // Dart got there first.
+    return false;
+  }
+
+  std::unique_ptr<TraySnapshot> snapshot = TraySnapshot::load();
+  if (!snapshot) {
+    return false;
+  }
+
+  // The application may have moved since, and without its icon the tray
+  // wouldn't show anyway.
+  if (!icon_cache_source_exists(snapshot->icon_path.c_str())) {
+    return false;
+  }
+
+  if (!init_tray(snapshot->tray_id.c_str())) {
+    return false;
+  }
+
+  set_tray_info(snapshot->title.empty() ? nullptr : snapshot->title.c_str(),
+                snapshot->icon_path.c_str(), nullptr);
+
+  restore_timer_id_ =
+      g_timeout_add_seconds(kRestoreTimeoutSeconds,
+                            Tray::static_restore_timeout_callback_fun, this);
+
+  std::shared_ptr<MenuManager> menu_manager = menu_manager_.lock();
+  if (!menu_manager || !snapshot->menu_list()) {
+    return true;
+  }
+
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, kMenuIdKey, fl_value_new_int(kSnapshotMenuId));
+  fl_value_set_string(args, kMenuListKey, snapshot->menu_list());
+  g_autoptr(FlMethodResponse) response =
+      menu_manager->handle_method(kCreateContextMenu, args);
+
+  std::shared_ptr<Menu> menu = menu_manager->get_menu(kSnapshotMenuId);
+  if (menu) {
+    menu->set_queue_clicks(true);
+    set_context_menu(kSnapshotMenuId);
+  }
+  return true;
+}
+
+void Tray::set_snapshot_enabled(bool enabled) {
+  snapshot_enabled_ = enabled;
+}
+
+void Tray::cancel_restore_timeout() {
+  if (restore_timer_id_ != 0) {
+    g_source_remove(restore_timer_id_);
+    restore_timer_id_ = 0;
+  }
+}
+
+void Tray::drop_restored_tray() {
+  destroy_indicator();
+
+  std::shared_ptr<MenuManager> menu_manager = menu_manager_.lock();
+  if (menu_manager) {
+    menu_manager->remove_menu(kSnapshotMenuId);
+  }
+
+  snapshot_.tray_id.clear();
+  snapshot_.title.clear();
+  snapshot_.icon_path.clear();
+  snapshot_.set_menu_list(nullptr);
+
+  // Saved again if Dart still initializes the tray with restoreOnLaunch.
+  TraySnapshot::remove();
+}
+
+void Tray::apply_update(const TrayUpdate& update) {
+  switch (update.field) {
+    case TrayUpdateField::kIcon:
+      set_tray_info(nullptr, update.text.c_str(), nullptr);
+      return;
+    case TrayUpdateField::kLabel:
+      set_tray_info(update.text.c_str(), nullptr, nullptr);
+      return;
+    default:
+      break;
+  }
+
+  std::shared_ptr<Menu> menu = get_context_menu();
+  if (!menu) {
+    return;
+  }
+
+  switch (update.field) {
+    case TrayUpdateField::kMenuItemLabel:
+      menu->set_label(update.menu_item_id, update.text.c_str());
+      break;
+    case TrayUpdateField::kMenuItemEnabled:
+      menu->set_enable(update.menu_item_id, update.flag);
+      break;
+    case TrayUpdateField::kMenuItemChecked:
+      menu->set_check(update.menu_item_id, update.flag);
+      break;
+    default:
+      break;
+  }
+}
+
+void Tray::schedule_save_snapshot() {
+  if (!snapshot_enabled_ || save_snapshot_timer_id_ != 0) {
+    return;
+  }
+
+  save_snapshot_timer_id_ = g_timeout_add_seconds(
+      kSaveSnapshotDelaySeconds,
+      Tray::static_save_snapshot_timeout_callback_fun, this);
+}
+
+void Tray::save_snapshot() {
+  if (snapshot_.tray_id.empty()) {
+    return;
+  }
+  snapshot_.save();
+}
+
+void Tray::schedule_prepare_popup() {
+  cancel_prepare_popup();
+
+  // Low priority, so it runs once the frames and method calls queued behind
+  // the menu update are handled.
+  prepare_popup_idle_id_ = g_idle_add_full(
+      G_PRIORITY_LOW, Tray::static_prepare_popup_idle_callback_fun, this,
+      nullptr);
+}
+
+void Tray::cancel_prepare_popup() {
+  if (prepare_popup_idle_id_ != 0) {
+    g_source_remove(prepare_popup_idle_id_);
+    prepare_popup_idle_id_ = 0;
+  }
+}
+
+bool Tray::set_image_frame(int64_t width, int64_t height, FlValue* rgba_value) {
+  if (width <= 0 || height <= 0 || width > G_MAXINT / 4 / height) {
+    return false;
+  }
+
+  size_t length = fl_value_get_length(rgba_value);
+  if (length != static_cast<size_t>(width * height * 4)) {
+    return false;
+  }
+
+  // A frame that wasn't shown yet is simply overwritten.
+  const uint8_t* rgba = fl_value_get_uint8_list(rgba_value);
+  image_frame_.assign(rgba, rgba + length);
+  image_frame_width_ = static_cast<int>(width);
+  image_frame_height_ = static_cast<int>(height);
+  image_frame_dirty_ = true;
+
+  schedule_image_frame();
+  return true;
+}
+
+void Tray::schedule_image_frame() {
+  if (image_frame_timer_id_ != 0) {
+    return;
+  }
+
+  gint64 elapsed_ms = (g_get_monotonic_time() - image_frame_shown_time_) /
+                      G_TIME_SPAN_MILLISECOND;
+  guint delay_ms = 0;
+  if (elapsed_ms < kMinImageFrameIntervalMs) {
+    delay_ms = static_cast<guint>(kMinImageFrameIntervalMs - elapsed_ms);
+  }
+
+  image_frame_timer_id_ = g_timeout_add(
+      delay_ms, Tray::static_image_frame_timeout_callback_fun, this);
+}
+
+void Tray::cancel_image_frame() {
+  if (image_frame_timer_id_ != 0) {
+    g_source_remove(image_frame_timer_id_);
+    image_frame_timer_id_ = 0;
+  }
+  image_frame_dirty_ = false;
+}
+
+void Tray::flush_image_frame() {
+  if (!image_frame_dirty_ || !app_indicator_) {
+    return;
+  }
+
+  image_frame_dirty_ = false;
+
+  g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_new_from_data(
+      image_frame_.data(), GDK_COLORSPACE_RGB, TRUE, 8, image_frame_width_,
+      image_frame_height_, image_frame_width_ * 4, nullptr, nullptr);
+
+  image_frame_file_index_ = 1 - image_frame_file_index_;
+  std::string path = image_frame_path(image_frame_file_index_);
+
+  image_frame_files_written_ = true;
+  g_autoptr(GError) error = nullptr;
+  if (!gdk_pixbuf_save(pixbuf, path.c_str(), "png", &error, "compression", "0",
+                       nullptr)) {
+    g_warning("Failed to write tray frame: %s", error->message);
+    return;
+  }
+
+  // Only the icon changes; a hidden or attention tray stays as it is.
+  indicator_api_->app_indicator_set_icon_full(app_indicator_, path.c_str(),
+                                              "icon");
+  image_frame_shown_ = true;
+  image_frame_shown_time_ = g_get_monotonic_time();
+}
+
+void Tray::remove_image_frames() {
+  if (!image_frame_files_written_) {
+    return;
+  }
+
+  for (int index = 0; index < 2; ++index) {
+    g_unlink(image_frame_path(index).c_str());
+  }
+  image_frame_files_written_ = false;
+  image_frame_shown_ = false;
+}
+
 #endif  // NATIVE_C
\ No newline at end of file
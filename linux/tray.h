@@ -3,34 +3,14 @@
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
-#ifdef HAVE_AYATANA
-#include <libayatana-appindicator/app-indicator.h>
-#else
-#include <libappindicator/app-indicator.h>
-#endif
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-typedef AppIndicator* (*app_indicator_new_fun)(const gchar*,
-                                               const gchar*,
-                                               AppIndicatorCategory);
-
-typedef void (*app_indicator_set_status_fun)(AppIndicator*, AppIndicatorStatus);
-typedef void (*app_indicator_set_icon_full_func)(AppIndicator* self,
-                                                 const gchar* icon_name,
-                                                 const gchar* icon_desc);
-typedef void (*app_indicator_set_attention_icon_full_fun)(AppIndicator*,
-                                                          const gchar*,
-                                                          const gchar*);
-typedef void (*app_indicator_set_label_func)(AppIndicator* self,
-                                             const gchar* label,
-                                             const gchar* guide);
-
-typedef void (*app_indicator_set_title_func)(AppIndicator* self,
-                                             const gchar* title);
-
-typedef const gchar* (*app_indicator_get_label_func)(AppIndicator* self);
-
-typedef void (*app_indicator_set_menu_fun)(AppIndicator*, GtkMenu*);
+#include "indicator_api.h"
+#include "tray_snapshot.h"
+#include "tray_update_queue.h"
 
 extern const char kInitSystemTray[];
 extern const char kSetSystemTrayInfo[];
@@ -38,7 +18,11 @@ extern const char kSetContextMenu[];
 extern const char kPopupContextMenu[];
 extern const char kGetTitle[];
 extern const char kDestroySystemTray[];
+extern const char kSetImageFrame[];
+extern const char kRegisterTrayStates[];
+extern const char kSetTrayState[];
 
+class Menu;
 class MenuManager;
 
 class Tray {
@@ -49,6 +33,21 @@ class Tray {
 
   void handle_method_call(FlMethodCall* method_call);
 
+  // Runs |method| with |args| and returns the response for Dart, e.g. for
+  // replaying recorded calls without a method channel.
+  FlMethodResponse* handle_method(const gchar* method, FlValue* args);
+
+  // Shows the tray and its menu as last saved, before Dart initializes it.
+  // Clicks on the restored menu are delivered once Dart sets a context menu.
+  // The tray is removed again if Dart doesn't initialize it in time.
+  //
+  // Only applications that passed restoreOnLaunch to initSystemTray have a
+  // snapshot saved.
+  bool restore_snapshot();
+
+  // Applies an update made through system_tray_api.h.
+  void apply_update(const TrayUpdate& update);
+
  protected:
   FlMethodResponse* init_tray(FlValue* args);
   FlMethodResponse* set_tray_info(FlValue* args);
@@ -56,6 +55,9 @@ class Tray {
   FlMethodResponse* popup_context_menu(FlValue* args);
   FlMethodResponse* get_title(FlValue* args);
   FlMethodResponse* destroy_system_tray(FlValue* args);
+  FlMethodResponse* set_image_frame(FlValue* args);
+  FlMethodResponse* register_tray_states(FlValue* args);
+  FlMethodResponse* set_tray_state(FlValue* args);
 
   bool init_tray(const char* tray_id);
   bool set_tray_info(const char* title,
@@ -63,6 +65,43 @@ class Tray {
                      const char* toolTip);
   void set_context_menu(int64_t context_menu_id);
   int64_t get_context_menu_id() const;
+  std::shared_ptr<Menu> get_context_menu() const;
+  bool popup_context_menu();
+  void schedule_prepare_popup();
+  void cancel_prepare_popup();
+  static gboolean static_prepare_popup_idle_callback_fun(gpointer user_data);
+  void deliver_queued_clicks(const std::shared_ptr<Menu>& menu);
+
+  // Follows the root item the indicator exports the menu through over
+  // dbusmenu, whose about-to-show tells when the panel opens the menu.
+  // Returns false if the indicator doesn't export one.
+  bool connect_menu_root();
+  void disconnect_menu_root();
+  static gboolean static_menu_about_to_show_callback_fun(GObject* root,
+                                                          Tray* self);
+
+  void set_snapshot_enabled(bool enabled);
+  void schedule_save_snapshot();
+  void save_snapshot();
+  void cancel_restore_timeout();
+  void drop_restored_tray();
+  static gboolean static_restore_timeout_callback_fun(gpointer user_data);
+  static gboolean static_save_snapshot_timeout_callback_fun(
+      gpointer user_data);
+
+  bool set_image_frame(int64_t width, int64_t height, FlValue* rgba_value);
+  void schedule_image_frame();
+  void cancel_image_frame();
+  void flush_image_frame();
+  void remove_image_frames();
+  static gboolean static_image_frame_timeout_callback_fun(gpointer user_data);
+
+  bool set_tray_state(const char* name);
+  void set_icon(const char* icon_path);
+  void set_attention_icon(const char* icon_path);
+  static void static_monitors_changed_callback_fun(GdkScreen* screen,
+                                                   Tray* self);
+  void monitors_changed_callback_fun(GdkScreen* screen);
 
   bool init_indicator_api();
   bool create_indicator(const char* tray_id);
@@ -70,24 +109,59 @@ class Tray {
   void hide_indicator();
 
  protected:
-  app_indicator_new_fun app_indicator_new_ = nullptr;
-  app_indicator_set_status_fun app_indicator_set_status_ = nullptr;
-  app_indicator_set_icon_full_func app_indicator_set_icon_full_ = nullptr;
-  app_indicator_set_attention_icon_full_fun
-      app_indicator_set_attention_icon_full_ = nullptr;
-  app_indicator_set_label_func app_indicator_set_label_ = nullptr;
-  app_indicator_set_title_func app_indicator_set_title_ = nullptr;
-  app_indicator_get_label_func app_indicator_get_label_ = nullptr;
-  app_indicator_set_menu_fun app_indicator_set_menu_ = nullptr;
+  // A named combination of icon, label and status, registered once and then
+  // switched to by name.
+  struct TrayState {
+    std::string icon_path;
+    // Empty for states without a title, which clear the label.
+    std::string label;
+    AppIndicatorStatus status = APP_INDICATOR_STATUS_ACTIVE;
+  };
+
+  // The appindicator entry points shared by all trays, once loaded.
+  const IndicatorApi* indicator_api_ = nullptr;
 
   FlMethodChannel* channel_ = nullptr;
   std::weak_ptr<MenuManager> menu_manager_;
 
-  bool indicator_api_inited_ = false;
 
   AppIndicator* app_indicator_ = nullptr;
+  std::string tray_id_;
 
   int context_menu_id_ = -1;
+  guint prepare_popup_idle_id_ = 0;
+  // The dbusmenu root item of the exported menu, see connect_menu_root().
+  GObject* menu_root_ = nullptr;
+
+  // Tracks the applied state; only written to disk when enabled.
+  TraySnapshot snapshot_;
+  bool snapshot_enabled_ = false;
+  guint save_snapshot_timer_id_ = 0;
+  // Pending while a restored tray waits for Dart to initialize it.
+  guint restore_timer_id_ = 0;
+
+  // The icons as given by Dart, re-rasterized when the scale factor changes.
+  std::string icon_path_;
+  std::string attention_icon_path_;
+
+  std::unordered_map<std::string, TrayState> tray_states_;
+  int scale_factor_ = 1;
+  GdkScreen* screen_ = nullptr;
+
+  // The latest raw icon frame from Dart. A frame that wasn't shown yet is
+  // overwritten by the next one, and frames are shown at most once per
+  // kMinImageFrameIntervalMs, a fixed rate cap.
+  std::vector<uint8_t> image_frame_;
+  bool image_frame_dirty_ = false;
+  int image_frame_width_ = 0;
+  int image_frame_height_ = 0;
+  int image_frame_file_index_ = 0;
+  // Whether frame files were written, and are to be removed with the tray.
+  bool image_frame_files_written_ = false;
+  // Whether the indicator shows a frame rather than icon_path_.
+  bool image_frame_shown_ = false;
+  gint64 image_frame_shown_time_ = 0;
+  guint image_frame_timer_id_ = 0;
 };
 
 #endif  // __TRAY_H__
\ No newline at end of file
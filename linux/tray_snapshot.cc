@@ -0,0 +1,141 @@
+#include "tray_snapshot.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'S', 'T', 'S', 'N', 'A', 'P', '0', '1'};
+
+constexpr char kTrayIdKey[] = "tray_id";
+constexpr char kTitleKey[] = "title";
+constexpr char kIconPathKey[] = "icon_path";
+constexpr char kMenuListKey[] = "menu_list";
+
+// One file per application, as the icon cache next to it is shared.
+std::string snapshot_path() {
+  const gchar* name = g_get_prgname();
+  g_autofree gchar* file_name =
+      g_strdup_printf("%s.snapshot", name ? name : "flutter");
+  g_autofree gchar* path = g_build_filename(g_get_user_cache_dir(),
+                                            "system_tray", file_name, nullptr);
+  return path;
+}
+
+std::string lookup_string(FlValue* map, const char* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (!value || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return "";
+  }
+  return fl_value_get_string(value);
+}
+
+}  // namespace
+
+TraySnapshot::~TraySnapshot() noexcept {
+  set_menu_list(nullptr);
+}
+
+// static
+std::unique_ptr<TraySnapshot> TraySnapshot::load() {
+  std::string path = snapshot_path();
+
+  g_autofree gchar* contents = nullptr;
+  gsize length = 0;
+  if (!g_file_get_contents(path.c_str(), &contents, &length, nullptr)) {
+    return nullptr;
+  }
+
+  if (length < sizeof(kSnapshotMagic) ||
+      memcmp(contents, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+    return nullptr;
+  }
+
+  g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+  g_autoptr(GBytes) payload =
+      g_bytes_new(contents + sizeof(kSnapshotMagic),
+                  length - sizeof(kSnapshotMagic));
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(FlValue) map = fl_message_codec_decode_message(
+      FL_MESSAGE_CODEC(codec), payload, &error);
+  if (!map || fl_value_get_type(map) != FL_VALUE_TYPE_MAP) {
+    g_warning("Ignoring corrupt tray snapshot %s", path.c_str());
+    return nullptr;
+  }
+
+  std::unique_ptr<TraySnapshot> snapshot = std::make_unique<TraySnapshot>();
+  snapshot->tray_id = lookup_string(map, kTrayIdKey);
+  snapshot->title = lookup_string(map, kTitleKey);
+  snapshot->icon_path = lookup_string(map, kIconPathKey);
+
+  FlValue* menu_list = fl_value_lookup_string(map, kMenuListKey);
+  if (menu_list && fl_value_get_type(menu_list) == FL_VALUE_TYPE_LIST) {
+    snapshot->set_menu_list(menu_list);
+  }
+
+  if (snapshot->tray_id.empty()) {
+    return nullptr;
+  }
+  return snapshot;
+}
+
+// static
+void TraySnapshot::remove() {
+  g_unlink(snapshot_path().c_str());
+}
+
+bool TraySnapshot::save() const {
+  g_autoptr(FlValue) map = fl_value_new_map();
+  fl_value_set_string_take(map, kTrayIdKey,
+                           fl_value_new_string(tray_id.c_str()));
+  fl_value_set_string_take(map, kTitleKey, fl_value_new_string(title.c_str()));
+  fl_value_set_string_take(map, kIconPathKey,
+                           fl_value_new_string(icon_path.c_str()));
+  if (menu_list_) {
+    fl_value_set_string(map, kMenuListKey, menu_list_);
+  }
+
+  g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GBytes) payload =
+      fl_message_codec_encode_message(FL_MESSAGE_CODEC(codec), map, &error);
+  if (!payload) {
+    g_warning("Failed to encode the tray snapshot: %s", error->message);
+    return false;
+  }
+
+  gsize length = 0;
+  const void* data = g_bytes_get_data(payload, &length);
+
+  g_autoptr(GByteArray) contents = g_byte_array_sized_new(
+      static_cast<guint>(sizeof(kSnapshotMagic) + length));
+  g_byte_array_append(contents, reinterpret_cast<const guint8*>(kSnapshotMagic),
+                      sizeof(kSnapshotMagic));
+  g_byte_array_append(contents, static_cast<const guint8*>(data),
+                      static_cast<guint>(length));
+
+  std::string path = snapshot_path();
+  g_autofree gchar* dir = g_path_get_dirname(path.c_str());
+  g_mkdir_with_parents(dir, 0700);
+
+  // Written to a temporary file and renamed, so a crash never leaves a
+  // truncated snapshot behind.
+  if (!g_file_set_contents(path.c_str(),
+                           reinterpret_cast<const gchar*>(contents->data),
+                           contents->len, &error)) {
+    g_warning("Failed to save the tray snapshot: %s", error->message);
+    return false;
+  }
+  return true;
+}
+
+void TraySnapshot::set_menu_list(FlValue* menu_list) {
+  if (menu_list_) {
+    fl_value_unref(menu_list_);
+  }
+  menu_list_ = menu_list ? fl_value_ref(menu_list) : nullptr;
+}
+
+FlValue* TraySnapshot::menu_list() const {
+  return menu_list_;
+}
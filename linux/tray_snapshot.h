@@ -0,0 +1,42 @@
+#ifndef __TRAY_SNAPSHOT_H__
+#define __TRAY_SNAPSHOT_H__
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <memory>
+#include <string>
+
+// The last tray state applied by Dart, saved under the user cache directory
+// so the next launch can show the tray and its menu before Dart runs.
+//
+// The file holds kSnapshotMagic followed by a map of the fields below,
+// encoded with the standard message codec.
+class TraySnapshot {
+ public:
+  TraySnapshot() = default;
+  TraySnapshot(const TraySnapshot&) = delete;
+  TraySnapshot& operator=(const TraySnapshot&) = delete;
+  ~TraySnapshot() noexcept;
+
+  // Returns the snapshot saved by the last launch of this application, or
+  // nullptr if there is none or it can't be read.
+  static std::unique_ptr<TraySnapshot> load();
+
+  // Deletes the saved snapshot, e.g. once the tray is destroyed.
+  static void remove();
+
+  bool save() const;
+
+  void set_menu_list(FlValue* menu_list);
+  FlValue* menu_list() const;
+
+  std::string tray_id;
+  std::string title;
+  std::string icon_path;
+
+ protected:
+  // The menu_list of the context menu's CreateContextMenu call.
+  FlValue* menu_list_ = nullptr;
+};
+
+#endif  // __TRAY_SNAPSHOT_H__
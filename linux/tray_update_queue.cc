@@ -0,0 +1,40 @@
+#include "tray_update_queue.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+TrayUpdateQueue::~TrayUpdateQueue() noexcept {
+  take();
+}
+
+bool TrayUpdateQueue::push(TrayUpdate update) {
+  Node* node = new Node{std::move(update), nullptr};
+  Node* head = head_.load(std::memory_order_relaxed);
+  do {
+    node->next = head;
+  } while (!head_.compare_exchange_weak(head, node, std::memory_order_release,
+                                        std::memory_order_relaxed));
+  // |node| may already be taken and freed here, so don't read it again.
+  return head == nullptr;
+}
+
+std::vector<TrayUpdate> TrayUpdateQueue::take() {
+  Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+
+  // Walking from the newest update, the first one seen for a field is the
+  // one that wins.
+  std::vector<TrayUpdate> updates;
+  std::set<std::pair<TrayUpdateField, int64_t>> seen;
+  while (node) {
+    Node* next = node->next;
+    if (seen.emplace(node->update.field, node->update.menu_item_id).second) {
+      updates.push_back(std::move(node->update));
+    }
+    delete node;
+    node = next;
+  }
+
+  std::reverse(updates.begin(), updates.end());
+  return updates;
+}
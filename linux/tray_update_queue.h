@@ -0,0 +1,55 @@
+#ifndef __TRAY_UPDATE_QUEUE_H__
+#define __TRAY_UPDATE_QUEUE_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Updates made from native code through system_tray_api.h.
+enum class TrayUpdateField : uint8_t {
+  kIcon = 0,
+  kLabel = 1,
+  kMenuItemLabel = 2,
+  kMenuItemEnabled = 3,
+  kMenuItemChecked = 4,
+};
+
+struct TrayUpdate {
+  TrayUpdateField field = TrayUpdateField::kIcon;
+  // Only set for the kMenuItem* fields.
+  int64_t menu_item_id = -1;
+  std::string text;
+  bool flag = false;
+};
+
+// A lock-free multi-producer, single-consumer queue of tray updates. Any
+// thread may push(), only the main thread calls take().
+class TrayUpdateQueue {
+ public:
+  TrayUpdateQueue() noexcept = default;
+  ~TrayUpdateQueue() noexcept;
+
+  TrayUpdateQueue(const TrayUpdateQueue&) = delete;
+  TrayUpdateQueue& operator=(const TrayUpdateQueue&) = delete;
+
+  // Returns true if the queue was empty, i.e. the consumer has to be woken
+  // up to take() this update.
+  bool push(TrayUpdate update);
+
+  // Returns all pending updates in the order they were pushed. Of several
+  // updates to the same field of the same item only the last one is kept.
+  std::vector<TrayUpdate> take();
+
+ protected:
+  struct Node {
+    TrayUpdate update;
+    Node* next;
+  };
+
+  // The most recently pushed update.
+  std::atomic<Node*> head_{nullptr};
+};
+
+#endif  // __TRAY_UPDATE_QUEUE_H__
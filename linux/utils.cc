@@ -0,0 +1,83 @@
+#include "utils.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace utils {
+
+int64_t get_resident_set_size() {
+  int64_t rss = 0;
+
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file) {
+    long size = 0;
+    long resident = 0;
+    if (fscanf(file, "%ld %ld", &size, &resident) == 2) {
+      rss = static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+    }
+    fclose(file);
+  }
+
+  return rss;
+}
+
+int64_t get_open_fd_count() {
+  DIR* dir = opendir("/proc/self/fd");
+  if (!dir) {
+    return -1;
+  }
+
+  int64_t count = 0;
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      count++;
+    }
+  }
+  closedir(dir);
+
+  // Don't count the descriptor used to list the others.
+  return count - 1;
+}
+
+int64_t get_process_uptime_us() {
+  char stat[1024] = {};
+  FILE* file = fopen("/proc/self/stat", "r");
+  if (!file) {
+    return -1;
+  }
+  size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+  fclose(file);
+  stat[length] = '\0';
+
+  // The command name may contain spaces, so fields are counted from the
+  // parenthesis closing it. starttime is the 22nd field, state the 3rd.
+  const char* fields = strrchr(stat, ')');
+  if (!fields) {
+    return -1;
+  }
+  unsigned long long start_ticks = 0;
+  if (sscanf(fields + 2,
+             "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d "
+             "%*d %*d %*d %llu",
+             &start_ticks) != 1) {
+    return -1;
+  }
+
+  double uptime = 0;
+  file = fopen("/proc/uptime", "r");
+  if (!file) {
+    return -1;
+  }
+  int scanned = fscanf(file, "%lf", &uptime);
+  fclose(file);
+  if (scanned != 1) {
+    return -1;
+  }
+
+  double start = static_cast<double>(start_ticks) / sysconf(_SC_CLK_TCK);
+  return static_cast<int64_t>((uptime - start) * 1000000);
+}
+
+}  // namespace utils
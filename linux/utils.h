@@ -0,0 +1,22 @@
+#ifndef __UTILS_H__
+#define __UTILS_H__
+
+#include <stdint.h>
+
+namespace utils {
+
+// Returns the resident set size of the current process in bytes, or 0 if it
+// could not be read.
+int64_t get_resident_set_size();
+
+// Returns the number of file descriptors open in the current process, or -1
+// if they could not be listed.
+int64_t get_open_fd_count();
+
+// Returns the time since the current process started in microseconds, with
+// clock tick resolution, or -1 if it could not be read.
+int64_t get_process_uptime_us();
+
+}  // namespace utils
+
+#endif  // __UTILS_H__
@@ -9,6 +9,7 @@ private let kMenuListKey = "menu_list"
 private let kIdKey = "id"
 private let kTypeKey = "type"
 private let kCheckboxKey = "checkbox"
+private let kRadioKey = "radio"
 private let kSeparatorKey = "separator"
 private let kSubMenuKey = "submenu"
 private let kLabelKey = "label"
@@ -241,6 +242,19 @@ class Menu: NSObject {
       menuItem.action = isEnabled ? #selector(onMenuItemSelectedCallback) : nil
       menuItem.tag = id
       menuItem.state = isChecked ? .on : .off
+      menuItem.representedObject = kCheckboxKey
+      menu.addItem(menuItem)
+    case kRadioKey:
+      let isChecked = item[kCheckedKey] as? Bool ?? false
+
+      let menuItem = NSMenuItem()
+      menuItem.title = label
+      menuItem.image = image
+      menuItem.target = self
+      menuItem.action = isEnabled ? #selector(onMenuItemSelectedCallback) : nil
+      menuItem.tag = id
+      menuItem.state = isChecked ? .on : .off
+      menuItem.representedObject = kRadioKey
       menu.addItem(menuItem)
     default:
       let menuItem = NSMenuItem()
@@ -255,11 +269,49 @@ class Menu: NSObject {
     return true
   }
 
+  // Checks a radio item and unchecks the rest of its group, the adjacent
+  // radio items of the same menu.
+  func checkRadioItem(_ menuItem: NSMenuItem) {
+    guard let menu = menuItem.menu else {
+      menuItem.state = .on
+      return
+    }
+
+    let items = menu.items
+    let index = menu.index(of: menuItem)
+    var first = index
+    while first > 0 && items[first - 1].representedObject as? String == kRadioKey {
+      first -= 1
+    }
+    var last = index
+    while last + 1 < items.count
+      && items[last + 1].representedObject as? String == kRadioKey
+    {
+      last += 1
+    }
+
+    for i in first...last {
+      items[i].state = i == index ? .on : .off
+    }
+  }
+
   @objc func onMenuItemSelectedCallback(_ sender: Any) {
     let menuItem = sender as! NSMenuItem
+    var arguments: [String: Any] = [kMenuIdKey: menuId, kMenuItemIdKey: menuItem.tag]
+
+    // Checkboxes and radio items are toggled here and Dart is told their new
+    // state, as on the other platforms.
+    if menuItem.representedObject as? String == kCheckboxKey {
+      menuItem.state = menuItem.state == .on ? .off : .on
+      arguments[kCheckedKey] = menuItem.state == .on
+    } else if menuItem.representedObject as? String == kRadioKey {
+      checkRadioItem(menuItem)
+      arguments[kCheckedKey] = true
+    }
+
     channel.invokeMethod(
       kMenuItemSelectedCallbackMethod,
-      arguments: [kMenuIdKey: menuId, kMenuItemIdKey: menuItem.tag],
+      arguments: arguments,
       result: nil)
   }
 }
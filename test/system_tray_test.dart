@@ -1,20 +1,303 @@
+import 'dart:io';
+
 import 'package:flutter/services.dart';
 import 'package:flutter_test/flutter_test.dart';
+import 'package:system_tray/src/utils.dart';
+import 'package:system_tray/system_tray.dart';
 
-void main() {
-  const MethodChannel channel = MethodChannel('flutter/system_tray');
+const String _kTrayChannel = 'flutter/system_tray/tray';
+const String _kMenuManagerChannel = 'flutter/system_tray/menu_manager';
+const String _kAppWindowChannel = 'flutter/system_tray/app_window';
+
+const List<String> _kChannels = [
+  _kTrayChannel,
+  _kMenuManagerChannel,
+  _kAppWindowChannel,
+];
+
+const String _kIcon = 'assets/app_icon.png';
+
+const StandardMethodCodec _codec = StandardMethodCodec();
+
+/// The traffic a flow is allowed to send on a channel.
+///
+/// Absolute icon paths depend on where the test runs, so the encoded size of
+/// each of [icons] is added to [bytes].
+class _Budget {
+  const _Budget(this.messages, this.bytes, {this.icons = const []});
+
+  final int messages;
+  final int bytes;
+  final List<String> icons;
+}
+
+/// Recorded budgets by flow and channel. Channels that aren't listed must
+/// stay silent.
+///
+/// When a change makes a flow cheaper, lower its budget here so the saving
+/// is kept.
+const Map<String, Map<String, _Budget>> _kBudgets = {
+  'init': {
+    _kAppWindowChannel: _Budget(1, 16),
+    _kTrayChannel: _Budget(1, 127, icons: [_kIcon]),
+  },
+  'menu build (10 items)': {
+    _kMenuManagerChannel: _Budget(1, 611),
+    _kTrayChannel: _Budget(1, 21),
+  },
+  'menu build (100 items)': {
+    _kMenuManagerChannel: _Budget(1, 5606),
+    _kTrayChannel: _Budget(1, 21),
+  },
+  'menu build (1000 items)': {
+    _kMenuManagerChannel: _Budget(1, 56368),
+    _kTrayChannel: _Budget(1, 21),
+  },
+  'label refresh': {
+    _kMenuManagerChannel: _Budget(1, 70),
+  },
+  'icon change': {
+    _kTrayChannel: _Budget(1, 63, icons: [_kIcon]),
+  },
+};
+
+class _ChannelTraffic {
+  int messages = 0;
+  int bytes = 0;
+  final List<String> methods = [];
+}
+
+final Map<String, _ChannelTraffic> _traffic = {};
+
+/// Items named "Item <i>", with a checkbox every fifth and a separator every
+/// tenth item.
+List<MenuItemBase> _menuItems(int count) {
+  return List<MenuItemBase>.generate(count, (i) {
+    if (i % 10 == 9) {
+      return MenuSeparator();
+    } else if (i % 5 == 4) {
+      return MenuItemCheckbox(label: 'Check $i');
+    }
+    return MenuItemLabel(label: 'Item $i');
+  });
+}
+
+Future<int> _encodedSize(String asset) async {
+  final String? path = await Utils.getIcon(asset);
+  return const StandardMessageCodec().encodeMessage(path)!.lengthInBytes;
+}
 
-  TestWidgetsFlutterBinding.ensureInitialized();
+Future<void> _expectWithinBudget(String flow) async {
+  await pumpEventQueue();
+
+  for (final channel in _kChannels) {
+    final _Budget budget = _kBudgets[flow]![channel] ?? const _Budget(0, 0);
+    final _ChannelTraffic traffic = _traffic[channel] ?? _ChannelTraffic();
+
+    int bytes = budget.bytes;
+    for (final icon in budget.icons) {
+      bytes += await _encodedSize(icon);
+    }
+
+    expect(traffic.messages, lessThanOrEqualTo(budget.messages),
+        reason: '$flow sent ${traffic.methods} on $channel');
+    expect(traffic.bytes, lessThanOrEqualTo(bytes),
+        reason: '$flow sent ${traffic.methods} on $channel');
+  }
+}
+
+Future<void> _buildMenu(SystemTray systemTray, List<MenuItemBase> items) async {
+  final Menu menu = Menu();
+  await menu.buildFrom(items);
+  await systemTray.setContextMenu(menu);
+}
+
+void main() {
+  final binding = TestWidgetsFlutterBinding.ensureInitialized();
 
   setUp(() {
-    channel.setMockMethodCallHandler((MethodCall methodCall) async {
-      return '42';
-    });
+    _traffic.clear();
+
+    for (final channel in _kChannels) {
+      binding.defaultBinaryMessenger.setMockMessageHandler(channel,
+          (ByteData? message) async {
+        final MethodCall call = _codec.decodeMethodCall(message);
+
+        final _ChannelTraffic traffic =
+            _traffic.putIfAbsent(channel, () => _ChannelTraffic());
+        traffic.messages++;
+        traffic.bytes += message?.lengthInBytes ?? 0;
+        traffic.methods.add(call.method);
+
+        return _codec.encodeSuccessEnvelope(true);
+      });
+    }
   });
 
   tearDown(() {
-    channel.setMockMethodCallHandler(null);
+    for (final channel in _kChannels) {
+      binding.defaultBinaryMessenger.setMockMessageHandler(channel, null);
+    }
+  });
+
+  group('channel traffic', () {
+    test('init', () async {
+      AppWindow();
+      await SystemTray().initSystemTray(
+        title: 'system tray',
+        iconPath: _kIcon,
+        toolTip: 'tooltip',
+      );
+
+      await _expectWithinBudget('init');
+    });
+
+    for (final count in [10, 100, 1000]) {
+      test('menu build ($count items)', () async {
+        await _buildMenu(SystemTray(), _menuItems(count));
+
+        await _expectWithinBudget('menu build ($count items)');
+      });
+    }
+
+    test('label refresh', () async {
+      final List<MenuItemBase> items = _menuItems(10);
+      await _buildMenu(SystemTray(), items);
+      await pumpEventQueue();
+      _traffic.clear();
+
+      await items.first.setLabel('Item 0 (updated)');
+
+      await _expectWithinBudget('label refresh');
+    });
+
+    test('icon change', () async {
+      await SystemTray().setImage(_kIcon);
+
+      await _expectWithinBudget('icon change');
+    });
+  }, skip: Platform.isMacOS ? 'icons are sent as base64 on macOS' : null);
+
+  group('native toggles', () {
+    Future<void> click(Menu menu, MenuItemBase item, bool checked) async {
+      await binding.defaultBinaryMessenger.handlePlatformMessage(
+          _kMenuManagerChannel,
+          _codec.encodeMethodCall(
+              MethodCall('MenuItemSelectedCallback', <String, dynamic>{
+            'menu_id': menu.menuId,
+            'generation': 1,
+            'menu_item_id': item.menuItemId,
+            'checked': checked,
+          })),
+          (_) {});
+    }
+
+    test('checkbox click is applied without a reply', () async {
+      final MenuItemCheckbox checkbox = MenuItemCheckbox(label: 'Check');
+      final Menu menu = Menu();
+      await menu.buildFrom([checkbox]);
+      await pumpEventQueue();
+      _traffic.clear();
+
+      await click(menu, checkbox, true);
+      await pumpEventQueue();
+
+      expect(checkbox.checked, isTrue);
+      expect(_traffic, isEmpty);
+    });
+
+    test('radio groups are exclusive', () async {
+      final List<MenuItemRadio> radios = List<MenuItemRadio>.generate(
+          3, (i) => MenuItemRadio(label: 'Radio $i', checked: i == 1));
+      final MenuItemRadio separate = MenuItemRadio(label: 'Separate');
+      final Menu menu = Menu();
+      await menu.buildFrom(
+          [...radios, MenuItemLabel(label: 'Label'), separate]);
+      await pumpEventQueue();
+      _traffic.clear();
+
+      expect(radios.map((e) => e.checked), [false, true, false]);
+      // A group of its own, checked like the native side checks it.
+      expect(separate.checked, isTrue);
+
+      await click(menu, radios[2], true);
+      await pumpEventQueue();
+
+      expect(radios.map((e) => e.checked), [false, false, true]);
+      expect(separate.checked, isTrue);
+      expect(_traffic, isEmpty);
+    });
   });
 
-  test('getPlatformVersion', () async {});
+  group('window events', () {
+    test('are passed to the handler', () async {
+      final AppWindow appWindow = AppWindow();
+      final List<String> events = [];
+      appWindow.registerWindowEventHandler(events.add);
+      await pumpEventQueue();
+
+      for (final event in [kAppWindowEventIconified, kAppWindowEventHidden]) {
+        await binding.defaultBinaryMessenger.handlePlatformMessage(
+            _kAppWindowChannel,
+            _codec.encodeMethodCall(MethodCall('WindowEventCallback', event)),
+            (_) {});
+      }
+
+      expect(events, [kAppWindowEventIconified, kAppWindowEventHidden]);
+    });
+  });
+
+  group('close to tray', () {
+    test('setCloseToTray reaches the app window channel', () async {
+      final AppWindow appWindow = AppWindow();
+      await pumpEventQueue();
+      _traffic.clear();
+
+      await appWindow.setCloseToTray(enabled: true);
+
+      expect(_traffic[_kAppWindowChannel]?.methods, ['SetCloseToTray']);
+    }, skip: !Platform.isLinux);
+  });
+
+  group('background serialization', () {
+    /// A bit of everything a menu can hold.
+    List<MenuItemBase> items() => [
+          MenuItemLabel(label: 'Label', image: _kIcon),
+          MenuItemCheckbox(label: 'Check', checked: true),
+          MenuSeparator(),
+          MenuItemRadio(label: 'Radio 0'),
+          MenuItemRadio(label: 'Radio 1', checked: true),
+          SubMenu(label: 'Submenu', image: _kIcon, children: [
+            MenuItemLabel(label: 'Nested', enabled: false),
+            MenuItemLabel(
+                label: 'Close', nativeAction: NativeMenuAction.closeAppWindow),
+          ]),
+        ];
+
+    /// The arguments of the CreateContextMenu call of [menu], without the
+    /// id that differs between menus.
+    Future<Map<dynamic, dynamic>> createContextMenu(Menu menu) async {
+      final List<MethodCall> calls = [];
+      binding.defaultBinaryMessenger.setMockMessageHandler(_kMenuManagerChannel,
+          (ByteData? message) async {
+        calls.add(_codec.decodeMethodCall(message));
+        return _codec.encodeSuccessEnvelope(true);
+      });
+
+      expect(await menu.buildFrom(items()), isTrue);
+      expect(calls.map((e) => e.method), ['CreateContextMenu']);
+
+      final Map<dynamic, dynamic> arguments = Map.of(calls.single.arguments);
+      expect(arguments.remove('menu_id'), menu.menuId);
+      return arguments;
+    }
+
+    test('sends the same payload as the foreground', () async {
+      final Map<dynamic, dynamic> foreground = await createContextMenu(Menu());
+      final Map<dynamic, dynamic> background =
+          await createContextMenu(Menu(serializeInBackground: true));
+
+      expect(background, foreground);
+    });
+  });
 }
@@ -0,0 +1,107 @@
+#include "encodable_menu_model.h"
+
+#include <string.h>
+
+#include <iterator>
+#include <string>
+
+#include "utils.h"
+
+namespace {
+
+constexpr char kIdKey[] = "id";
+constexpr char kTypeKey[] = "type";
+constexpr char kLabelKey[] = "label";
+constexpr char kImageKey[] = "image";
+constexpr char kEnabledKey[] = "enabled";
+constexpr char kCheckedKey[] = "checked";
+constexpr char kSubMenuKey[] = "submenu";
+constexpr char kNativeActionKey[] = "native_action";
+
+constexpr const char* kTypeNames[] = {"label", "checkbox", "submenu",
+                                      "separator", "radio"};
+
+const char* LookupString(const flutter::EncodableMap& map, const char* key) {
+  const auto* value = std::get_if<std::string>(utils::ValueOrNull(map, key));
+  return value ? value->c_str() : nullptr;
+}
+
+bool LookupType(const flutter::EncodableMap& map, MenuItemType* type) {
+  const char* name = LookupString(map, kTypeKey);
+  if (!name) {
+    return false;
+  }
+
+  // Anything else is shown as a plain label, as it always was.
+  *type = MenuItemType::kLabel;
+  for (size_t i = 0; i < std::size(kTypeNames); ++i) {
+    if (strcmp(name, kTypeNames[i]) == 0) {
+      *type = static_cast<MenuItemType>(i);
+    }
+  }
+  return true;
+}
+
+bool ParseList(const flutter::EncodableList& list, MenuModel* model) {
+  for (const auto& item : list) {
+    const auto* map = std::get_if<flutter::EncodableMap>(&item);
+    if (!map) {
+      return false;
+    }
+
+    MenuItemFields fields;
+    if (!LookupType(*map, &fields.type)) {
+      return false;
+    }
+
+    // The codec sends small ints as int32 and larger ones as int64.
+    const flutter::EncodableValue* id = utils::ValueOrNull(*map, kIdKey);
+    if (const auto* id32 = std::get_if<int32_t>(id)) {
+      fields.id = *id32;
+    } else if (const auto* id64 = std::get_if<int64_t>(id)) {
+      fields.id = *id64;
+    }
+
+    fields.label = LookupString(*map, kLabelKey);
+    fields.image = LookupString(*map, kImageKey);
+    fields.native_action = LookupString(*map, kNativeActionKey);
+
+    const auto* enabled =
+        std::get_if<bool>(utils::ValueOrNull(*map, kEnabledKey));
+    if (enabled) {
+      fields.enabled = *enabled;
+    }
+
+    const auto* checked =
+        std::get_if<bool>(utils::ValueOrNull(*map, kCheckedKey));
+    if (checked) {
+      fields.checked = *checked;
+    }
+
+    uint32_t index = model->append_item(fields);
+
+    if (fields.type == MenuItemType::kSubMenu) {
+      const auto* children = std::get_if<flutter::EncodableList>(
+          utils::ValueOrNull(*map, kSubMenuKey));
+      if (!children || !ParseList(*children, model)) {
+        return false;
+      }
+      model->end_submenu(index);
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ParseMenuModel(const flutter::EncodableList& menu_list, MenuModel* model) {
+  model->clear();
+  model->reserve(menu_list.size(), 0);
+
+  if (!ParseList(menu_list, model)) {
+    model->clear();
+    return false;
+  }
+  model->check_radio_groups();
+  return true;
+}
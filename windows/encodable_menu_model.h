@@ -0,0 +1,12 @@
+#ifndef __ENCODABLE_MENU_MODEL_H__
+#define __ENCODABLE_MENU_MODEL_H__
+
+#include <flutter/encodable_value.h>
+
+#include "../common/menu_model.h"
+
+// Parses the menu_list of a CreateContextMenu call into |model|. Returns false
+// if it is malformed, leaving |model| cleared.
+bool ParseMenuModel(const flutter::EncodableList& menu_list, MenuModel* model);
+
+#endif  // __ENCODABLE_MENU_MODEL_H__
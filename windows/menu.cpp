@@ -3,6 +3,7 @@
 #include <winuser.h>
 
 #include <memory>
+#include <vector>
 
 #include "errors.h"
 #include "utils.h"
@@ -15,10 +16,7 @@ constexpr int kDefaultIconSizeHeight = 32;
 constexpr char kMenuIdKey[] = "menu_id";
 constexpr char kMenuItemIdKey[] = "menu_item_id";
 constexpr char kMenuListKey[] = "menu_list";
-constexpr char kIdKey[] = "id";
-constexpr char kTypeKey[] = "type";
-constexpr char kSeparatorKey[] = "separator";
-constexpr char kSubMenuKey[] = "submenu";
+constexpr char kGenerationKey[] = "generation";
 constexpr char kLabelKey[] = "label";
 constexpr char kImageKey[] = "image";
 constexpr char kEnabledKey[] = "enabled";
@@ -52,6 +50,12 @@ bool Menu::CreateContextMenu(
       break;
     }
 
+    const auto* generation =
+        std::get_if<int>(utils::ValueOrNull(*params, kGenerationKey));
+    if (generation) {
+      generation_ = *generation;
+    }
+
     if (!CreateContextMenu(*list)) {
       break;
     }
@@ -210,21 +214,16 @@ void Menu::SetCheck(
 bool Menu::CreateContextMenu(const flutter::EncodableList& representation) {
   bool result = false;
 
-  HMENU menu = nullptr;
   do {
-    menu = CreatePopupMenu();
-    if (!ValueToMenu(menu, representation)) {
+    if (!ParseMenuModel(representation, &model_)) {
       break;
     }
 
-    menu_ = menu;
+    menu_ = CreatePopupMenu();
+    RenderMenu(menu_, 0, model_.size());
     result = true;
   } while (false);
 
-  if (!result) {
-    DestroyMenu(menu);
-  }
-
   return result;
 }
 
@@ -240,20 +239,34 @@ void Menu::PopupContextMenu(HWND window, const POINT& pt) {
       static_cast<int>(TrackPopupMenu(GetMenu(), TPM_LEFTBUTTON | TPM_RETURNCMD,
                                       pt.x, pt.y, 0, window, nullptr));
   if (menu_item_id > 0) {
+    flutter::EncodableMap arguments{
+        {flutter::EncodableValue(kMenuIdKey),
+         flutter::EncodableValue(MenuId())},
+        {flutter::EncodableValue(kGenerationKey),
+         flutter::EncodableValue(generation_)},
+        {flutter::EncodableValue(kMenuItemIdKey),
+         flutter::EncodableValue(menu_item_id)}};
+
+    // Win32 menus don't toggle by themselves, so checkboxes and radio items
+    // are toggled here and Dart is told their new state.
+    if (model_.toggle(menu_item_id)) {
+      SetCheckState(menu_item_id);
+      arguments[flutter::EncodableValue(kCheckedKey)] =
+          flutter::EncodableValue(model_.checked(model_.find(menu_item_id)));
+    }
+
     if (!channel_.expired()) {
       std::shared_ptr<flutter::MethodChannel<>> channel = channel_.lock();
       channel->InvokeMethod(
           kMenuItemSelectedCallbackMethod,
-          std::make_unique<flutter::EncodableValue>(
-              flutter::EncodableMap{{flutter::EncodableValue(kMenuIdKey),
-                                     flutter::EncodableValue(MenuId())},
-                                    {flutter::EncodableValue(kMenuItemIdKey),
-                                     flutter::EncodableValue(menu_item_id)}}));
+          std::make_unique<flutter::EncodableValue>(std::move(arguments)));
     }
   }
 }
 
 void Menu::SetLabel(int menu_item_id, const std::string& label) {
+  model_.set_label(menu_item_id, label.c_str());
+
   std::wstring label_u = utils::Utf16FromUtf8(label);
 
   MENUITEMINFO mii = {sizeof(MENUITEMINFO)};
@@ -264,6 +277,8 @@ void Menu::SetLabel(int menu_item_id, const std::string& label) {
 }
 
 void Menu::SetImage(int menu_item_id, const std::string& image) {
+  model_.set_image(menu_item_id, image.c_str());
+
   std::wstring image_u = utils::Utf16FromUtf8(image);
 
   int x = /*GetSystemMetrics(SM_CXICON)*/ kDefaultIconSizeWidth;
@@ -278,16 +293,39 @@ void Menu::SetImage(int menu_item_id, const std::string& image) {
 }
 
 void Menu::SetEnable(int menu_item_id, bool enabled) {
-  MENUITEMINFO mii = {sizeof(MENUITEMINFO)};
-  mii.fMask = MIIM_STATE;
-  mii.fState = (enabled ? MFS_ENABLED : MFS_DISABLED);
-  SetMenuItemInfo(GetMenu(), static_cast<UINT>(menu_item_id), FALSE, &mii);
+  model_.set_enabled(menu_item_id, enabled);
+  SetState(menu_item_id);
 }
 
 void Menu::SetCheck(int menu_item_id, bool checked) {
+  if (model_.set_checked(menu_item_id, checked)) {
+    SetCheckState(menu_item_id);
+  }
+}
+
+void Menu::SetCheckState(int menu_item_id) {
+  // Checking a radio item unchecks the rest of its group.
+  uint32_t index = model_.find(menu_item_id);
+  std::vector<uint32_t> group = model_.radio_group(index);
+  if (group.empty()) {
+    group.push_back(index);
+  }
+  for (uint32_t i : group) {
+    SetState(static_cast<int>(model_.id(i)));
+  }
+}
+
+void Menu::SetState(int menu_item_id) {
+  uint32_t index = model_.find(menu_item_id);
+  if (index == kNoMenuItem) {
+    return;
+  }
+
+  // MIIM_STATE replaces all state flags, so enabling an item mustn't clear
+  // its check mark and vice versa.
   MENUITEMINFO mii = {sizeof(MENUITEMINFO)};
   mii.fMask = MIIM_STATE;
-  mii.fState = (checked ? MFS_CHECKED : MFS_UNCHECKED);
+  mii.fState = MenuItemState(index);
   SetMenuItemInfo(GetMenu(), static_cast<UINT>(menu_item_id), FALSE, &mii);
 }
 
@@ -299,99 +337,70 @@ HMENU Menu::GetMenu() const {
   return menu_;
 }
 
-bool Menu::ValueToMenu(HMENU menu,
-                       const flutter::EncodableList& representation) {
-  for (const auto& item : representation) {
-    if (!ValueToMenuItem(menu, std::get<flutter::EncodableMap>(item))) {
-      return false;
-    }
+void Menu::RenderMenu(HMENU menu, uint32_t begin, uint32_t end) {
+  for (uint32_t i = begin; i < end; i = model_.end(i)) {
+    RenderMenuItem(menu, i);
   }
-  return true;
 }
 
-bool Menu::ValueToMenuItem(HMENU menu,
-                           const flutter::EncodableMap& representation) {
-  const auto* type =
-      std::get_if<std::string>(utils::ValueOrNull(representation, kTypeKey));
-  if (!type) {
-    return false;
+void Menu::RenderMenuItem(HMENU menu, uint32_t index) {
+  MenuItemType type = model_.type(index);
+  if (type == MenuItemType::kSeparator) {
+    AppendMenu(menu, MF_SEPARATOR, 0, nullptr);
+    return;
   }
 
-  if (type->compare(kSeparatorKey) == 0) {
-    AppendMenu(menu, MF_SEPARATOR, 0, nullptr);
-  } else {
-    const auto* id =
-        std::get_if<int32_t>(utils::ValueOrNull(representation, kIdKey));
-    UINT menu_item_id = id ? *id : -1;
+  UINT menu_item_id = static_cast<UINT>(model_.id(index));
+  std::wstring label_u = utils::Utf16FromUtf8(model_.label(index));
 
-    const auto* label =
-        std::get_if<std::string>(utils::ValueOrNull(representation, kLabelKey));
-    std::wstring label_u(label ? utils::Utf16FromUtf8(*label) : L"");
+  MENUITEMINFO mii = {sizeof(MENUITEMINFO)};
 
-    const auto* image =
-        std::get_if<std::string>(utils::ValueOrNull(representation, kImageKey));
+  if (model_.id(index) >= 0) {
+    mii.fMask |= MIIM_ID;
+    mii.wID = menu_item_id;
+  }
 
-    const auto* enabled =
-        std::get_if<bool>(utils::ValueOrNull(representation, kEnabledKey));
+  if (type == MenuItemType::kRadio) {
+    mii.fMask |= MIIM_FTYPE;
+    mii.fType = MFT_RADIOCHECK;
+  }
 
-    MENUITEMINFO mii = {sizeof(MENUITEMINFO)};
+  mii.fMask |= MIIM_STATE;
+  mii.fState = MenuItemState(index);
 
-    if (id) {
-      mii.fMask |= MIIM_ID;
-      mii.wID = menu_item_id;
-    }
+  mii.fMask |= MIIM_STRING;
+  mii.dwTypeData = label_u.data();
+  mii.cch = static_cast<UINT>(label_u.length());
 
-    if (enabled) {
-      mii.fMask |= MIIM_STATE;
-      mii.fState = *enabled ? MFS_ENABLED : MFS_DISABLED;
-    }
+  const char* image = model_.image(index);
+  if (*image) {
+    std::wstring image_u = utils::Utf16FromUtf8(image);
 
-    if (label) {
-      mii.fMask |= MIIM_STRING;
-      mii.dwTypeData = label_u.data();
-      mii.cch = static_cast<UINT>(label_u.length());
-    }
+    int x = /*GetSystemMetrics(SM_CXICON)*/ kDefaultIconSizeWidth;
+    int y = /*GetSystemMetrics(SM_CYICON)*/ kDefaultIconSizeHeight;
 
-    if (image) {
-      std::wstring image_u = utils::Utf16FromUtf8(*image);
+    mii.fMask |= MIIM_BITMAP;
+    mii.hbmpItem = static_cast<HBITMAP>(LoadImage(
+        nullptr, image_u.c_str(), IMAGE_BITMAP, x, y, LR_LOADFROMFILE));
+  }
 
-      int x = /*GetSystemMetrics(SM_CXICON)*/ kDefaultIconSizeWidth;
-      int y = /*GetSystemMetrics(SM_CYICON)*/ kDefaultIconSizeHeight;
+  mii.fMask |= MIIM_DATA;
+  mii.dwItemData = static_cast<ULONG_PTR>(MenuId());
 
-      // printf("cxicon: %d, cyicon: %d, image:%s\n", x, y, image->c_str());
+  if (type == MenuItemType::kSubMenu) {
+    HMENU submenu = ::CreatePopupMenu();
+    RenderMenu(submenu, index + 1, model_.end(index));
+    mii.fMask |= MIIM_SUBMENU;
+    mii.hSubMenu = submenu;
+  }
 
-      mii.fMask |= MIIM_BITMAP;
-      mii.hbmpItem = static_cast<HBITMAP>(LoadImage(
-          nullptr, image_u.c_str(), IMAGE_BITMAP, x, y, LR_LOADFROMFILE));
-    }
+  InsertMenuItem(menu, menu_item_id, FALSE, &mii);
+}
 
-    mii.fMask |= MIIM_DATA;
-    mii.dwItemData = static_cast<ULONG_PTR>(MenuId());
-
-    if (type->compare(kSubMenuKey) == 0) {
-      const auto* children = std::get_if<flutter::EncodableList>(
-          utils::ValueOrNull(representation, kSubMenuKey));
-      if (children) {
-        HMENU submenu = ::CreatePopupMenu();
-        if (ValueToMenu(submenu, *children)) {
-          mii.fMask |= MIIM_SUBMENU;
-          mii.hSubMenu = submenu;
-          InsertMenuItem(menu, menu_item_id, FALSE, &mii);
-        } else {
-          DestroyMenu(submenu);
-        }
-      }
-    } else {
-      const auto* checked =
-          std::get_if<bool>(utils::ValueOrNull(representation, kCheckedKey));
-      if (checked) {
-        mii.fMask |= MIIM_STATE;
-        mii.fState = *checked ? MFS_CHECKED : MFS_UNCHECKED;
-      }
-
-      InsertMenuItem(menu, menu_item_id, FALSE, &mii);
-    }
+UINT Menu::MenuItemState(uint32_t index) const {
+  UINT state = model_.enabled(index) ? MFS_ENABLED : MFS_DISABLED;
+  if (model_.checked(index)) {
+    state |= MFS_CHECKED;
   }
-
-  return true;
+  return state;
 }
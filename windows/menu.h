@@ -10,6 +10,8 @@
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 
+#include "encodable_menu_model.h"
+
 class Menu {
  public:
   Menu(std::weak_ptr<flutter::MethodChannel<>> channel, int menu_id) noexcept;
@@ -36,8 +38,10 @@ class Menu {
   void PopupContextMenu(HWND window, const POINT& pt);
 
  protected:
-  bool ValueToMenu(HMENU menu, const flutter::EncodableList& representation);
-  bool ValueToMenuItem(HMENU menu, const flutter::EncodableMap& representation);
+  // Appends the items from |begin| up to |end| of model_ to |menu|.
+  void RenderMenu(HMENU menu, uint32_t begin, uint32_t end);
+  void RenderMenuItem(HMENU menu, uint32_t index);
+  UINT MenuItemState(uint32_t index) const;
 
   bool CreateContextMenu(const flutter::EncodableList& representation);
   void DestroyContextMenu();
@@ -46,6 +50,8 @@ class Menu {
   void SetImage(int menu_item_id, const std::string& image);
   void SetEnable(int menu_item_id, bool enabled);
   void SetCheck(int menu_item_id, bool checked);
+  void SetState(int menu_item_id);
+  void SetCheckState(int menu_item_id);
 
   int MenuId() const;
 
@@ -53,7 +59,9 @@ class Menu {
   std::weak_ptr<flutter::MethodChannel<>> channel_;
 
   int menu_id_ = -1;
+  int generation_ = 0;
 
+  MenuModel model_;
   HMENU menu_ = nullptr;
 };
 